@@ -0,0 +1,115 @@
+/*
+ * analyzer.c: Stream health statistics of the timeshift recording
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include "analyzer.h"
+
+#include <vdr/channels.h>
+
+cPermashiftAnalyzer::cPermashiftAnalyzer(const cChannel *Channel) :
+	cReceiver(Channel, MINPRIORITY),
+	m_channelName(Channel->Name()), m_startTime(time(NULL)), m_numPids(0)
+{
+	memset(m_slot, 0, sizeof(m_slot));
+	memset(m_stats, 0, sizeof(m_stats));
+}
+
+cPermashiftAnalyzer::~cPermashiftAnalyzer()
+{
+	Detach();
+}
+
+void cPermashiftAnalyzer::Activate(bool On)
+{
+	if (On)
+	{
+		m_startTime = time(NULL);
+	}
+}
+
+void cPermashiftAnalyzer::Receive(uchar *Data, int Length)
+{
+	for (; Length >= TS_SIZE; Data += TS_SIZE, Length -= TS_SIZE)
+	{
+		int pid = ((Data[1] & 0x1F) << 8) | Data[2];
+		int slot = m_slot[pid];
+		if (slot == 0)
+		{
+			if (m_numPids >= ANALYZERMAXPIDS)
+			{
+				continue;
+			}
+			slot = m_slot[pid] = ++m_numPids;
+			m_stats[slot - 1].pid = pid;
+			m_stats[slot - 1].lastCc = -1;
+		}
+		tPidStats &stats = m_stats[slot - 1];
+
+		stats.packets++;
+		stats.teiErrors += (Data[1] & 0x80) >> 7;
+		stats.scrambled += (Data[3] & 0xC0) != 0;
+
+		// a signalled discontinuity lets the counter start anew
+		if ((Data[3] & 0x20) && Data[4] > 0 && (Data[5] & 0x80))
+		{
+			stats.lastCc = -1;
+		}
+
+		// the counter only advances with a payload, a single repetition is allowed
+		if (Data[3] & 0x10)
+		{
+			int cc = Data[3] & 0x0F;
+			if (stats.lastCc < 0)
+			{
+				stats.repeated = false;
+			}
+			else if (cc == stats.lastCc)
+			{
+				if (stats.repeated)
+				{
+					stats.ccErrors++;
+				}
+				stats.repeated = true;
+			}
+			else
+			{
+				if (cc != ((stats.lastCc + 1) & 0x0F))
+				{
+					stats.ccErrors++;
+				}
+				stats.repeated = false;
+			}
+			stats.lastCc = cc;
+		}
+	}
+}
+
+void cPermashiftAnalyzer::Totals(unsigned int &packets, unsigned int &ccErrors, unsigned int &teiErrors, unsigned int &scrambled)
+{
+	packets = ccErrors = teiErrors = scrambled = 0;
+	for (int i = 0; i < m_numPids; i++)
+	{
+		packets += m_stats[i].packets;
+		ccErrors += m_stats[i].ccErrors;
+		teiErrors += m_stats[i].teiErrors;
+		scrambled += m_stats[i].scrambled;
+	}
+}
+
+void cPermashiftAnalyzer::LogSummary(void)
+{
+	int seconds = max(1, int(time(NULL) - m_startTime));
+	for (int i = 0; i < m_numPids; i++)
+	{
+		const tPidStats &stats = m_stats[i];
+		if (stats.ccErrors || stats.teiErrors || stats.scrambled)
+		{
+			isyslog("Permashift: %s PID %d: %u continuity errors, %u transport errors, %u scrambled, %d kbit/s",
+				*m_channelName, stats.pid, stats.ccErrors, stats.teiErrors, stats.scrambled,
+				int(stats.packets * (long long)TS_SIZE * 8 / 1000 / seconds));
+		}
+	}
+}
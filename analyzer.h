@@ -0,0 +1,56 @@
+/*
+ * analyzer.h: Stream health statistics of the timeshift recording
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __PERMASHIFT_ANALYZER_H
+#define __PERMASHIFT_ANALYZER_H
+
+#include <vdr/receiver.h>
+
+#define ANALYZERMAXPIDS  64
+
+// Watches the packets of the recorded channel next to VDR's recorder and
+// counts continuity errors, transport errors and scrambled packets per PID.
+// Receive() is called for every packet in the device's thread, so it only
+// does table lookups and counting.
+
+class cPermashiftAnalyzer : public cReceiver
+{
+private:
+	struct tPidStats
+	{
+		int pid;
+		int lastCc;
+		bool repeated;
+		unsigned int packets;
+		unsigned int ccErrors;
+		unsigned int teiErrors;
+		unsigned int scrambled;
+	};
+
+	cString m_channelName;
+	time_t m_startTime;
+	// slot + 1 in m_stats for each PID, 0 = not seen yet
+	uchar m_slot[0x2000];
+	tPidStats m_stats[ANALYZERMAXPIDS];
+	int m_numPids;
+
+protected:
+	virtual void Activate(bool On);
+	virtual void Receive(uchar *Data, int Length);
+
+public:
+	cPermashiftAnalyzer(const cChannel *Channel);
+	virtual ~cPermashiftAnalyzer();
+
+	// sums over all PIDs
+	void Totals(unsigned int &packets, unsigned int &ccErrors, unsigned int &teiErrors, unsigned int &scrambled);
+
+	// write a summary of PIDs with errors to the log
+	void LogSummary(void);
+};
+
+#endif
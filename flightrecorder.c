@@ -0,0 +1,81 @@
+/*
+ * flightrecorder.c: In-memory history of the plugin's decisions
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include "flightrecorder.h"
+#include "statistics.h"
+
+cPermashiftFlightRecorder g_flightRecorder;
+
+cPermashiftFlightRecorder::cPermashiftFlightRecorder(void) :
+	m_next(0), m_lastAutoDump(0)
+{
+	memset(m_events, 0, sizeof(m_events));
+}
+
+void cPermashiftFlightRecorder::Add(eFlightEvent type, int channel, const void* timer, bool success, uint64_t durationUs)
+{
+	uint64_t index = __sync_fetch_and_add(&m_next, 1);
+	tFlightEvent &e = m_events[index & (FLIGHTRECORDEREVENTS - 1)];
+	e.timeUs = cPermashiftStatistics::Now();
+	e.timer = (uintptr_t)timer;
+	e.durationUs = durationUs > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)durationUs;
+	e.channel = channel;
+	e.type = type;
+	e.success = success;
+}
+
+cString cPermashiftFlightRecorder::Dump(const char* name)
+{
+	if (*m_directory == NULL)
+	{
+		return NULL;
+	}
+
+	time_t now = time(NULL);
+	cString fileName = AddDirectory(m_directory, name);
+
+	uint64_t next = m_next;
+	uint64_t count = min(next, (uint64_t)FLIGHTRECORDEREVENTS);
+
+	tFlightHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FLIGHTRECORDERMAGIC, sizeof(header.magic));
+	header.eventSize = sizeof(tFlightEvent);
+	header.count = count;
+	header.realTime = now;
+	header.monotonicUs = cPermashiftStatistics::Now();
+
+	// written to a temporary file and renamed, so the previous dump stays
+	// intact until the new one is complete
+	cSafeFile f(fileName);
+	if (!f.Open())
+	{
+		return NULL;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	for (uint64_t i = next - count; ok && i < next; i++)
+	{
+		ok = fwrite(&m_events[i & (FLIGHTRECORDEREVENTS - 1)], sizeof(tFlightEvent), 1, f) == 1;
+	}
+	if (!f.Close() || !ok)
+	{
+		LOG_ERROR_STR(*fileName);
+		return NULL;
+	}
+	isyslog("Permashift: Wrote %d events to %s", int(count), *fileName);
+	return fileName;
+}
+
+void cPermashiftFlightRecorder::DumpOnError(void)
+{
+	time_t now = time(NULL);
+	if (now - m_lastAutoDump >= 60)
+	{
+		m_lastAutoDump = now;
+		Dump(FLIGHTRECORDERERRFILE);
+	}
+}
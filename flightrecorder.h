@@ -0,0 +1,86 @@
+/*
+ * flightrecorder.h: In-memory history of the plugin's decisions
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __PERMASHIFT_FLIGHTRECORDER_H
+#define __PERMASHIFT_FLIGHTRECORDER_H
+
+#include <stdint.h>
+#include <vdr/tools.h>
+
+#define FLIGHTRECORDEREVENTS  4096 // must be a power of two
+#define FLIGHTRECORDERMAGIC   "PSHFTFR1"
+#define FLIGHTRECORDERFILE    "flightrecorder.bin"
+#define FLIGHTRECORDERERRFILE "flightrecorder-error.bin"
+
+enum eFlightEvent
+{
+	feZapStart = 1,
+	feZapEnd,
+	feRecordingStart,
+	feRecordingStop,
+	feTimerAdd,
+	feTimerDel,
+	feDelete,
+	feRemove,
+	feTimerGone,
+	fePromoted,
+	feStall
+};
+
+// One event, 32 bytes. A dump file starts with tFlightHeader, followed by
+// 'count' events, oldest first, in the byte order of the machine.
+
+struct tFlightEvent
+{
+	uint64_t timeUs;       // monotonic, see cPermashiftStatistics::Now()
+	uint64_t timer;        // address of the cTimer involved, 0 = none
+	uint32_t durationUs;
+	int32_t channel;
+	uint8_t type;          // eFlightEvent
+	uint8_t success;
+	uint8_t reserved[6];
+};
+
+struct tFlightHeader
+{
+	char magic[8];
+	uint32_t eventSize;
+	uint32_t count;
+	int64_t realTime;      // time(NULL) at dump time
+	uint64_t monotonicUs;  // timeUs at dump time
+};
+
+// Add() may be called from any thread. It reserves a slot with an atomic
+// increment and never waits. A dump racing with writers may contain a
+// half written event, which is acceptable for post-mortem analysis.
+
+class cPermashiftFlightRecorder
+{
+private:
+	tFlightEvent m_events[FLIGHTRECORDEREVENTS];
+	uint64_t m_next;
+	cString m_directory;
+	time_t m_lastAutoDump;
+
+public:
+	cPermashiftFlightRecorder(void);
+
+	void SetDirectory(const char* directory) { m_directory = directory; };
+
+	void Add(eFlightEvent type, int channel, const void* timer = NULL, bool success = true, uint64_t durationUs = 0);
+
+	// write all events to the given file in our directory, replacing an
+	// older dump, returns its full name or NULL
+	cString Dump(const char* name = FLIGHTRECORDERFILE);
+	// dump to FLIGHTRECORDERERRFILE after something went wrong,
+	// at most once a minute
+	void DumpOnError(void);
+};
+
+extern cPermashiftFlightRecorder g_flightRecorder;
+
+#endif
@@ -5,24 +5,65 @@
  *
  */
 
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
 #include <vdr/plugin.h>
 #include <vdr/status.h>
 #include <vdr/menu.h>
+#include <vdr/player.h>
 #include <vdr/timers.h>
 #include <vdr/shutdown.h>
 #include <vdr/interface.h>
+#include <vdr/remote.h>
+#include <vdr/videodir.h>
+
+#include "analyzer.h"
+#include "flightrecorder.h"
+#include "prefetcher.h"
+#include "probes.h"
+#include "remover.h"
+#include "services.h"
+#include "snapshot.h"
+#include "statistics.h"
+#include "watchdog.h"
 
 #define EXPIRECANCELPROMPT    300 // seconds to wait in user prompt before expiring recording
+#define JOURNALFILE           "journal" // state of a recording kept over a restart
+
+// file system types we consider remote (see statfs(2))
+#define NFS_SUPER_MAGIC       0x6969
+#define SMB_SUPER_MAGIC       0x517B
+#define CIFS_MAGIC_NUMBER     0xFF534D42
+#define SMB2_MAGIC_NUMBER     0xFE534D42
 
 static const char *VERSION        = "0.5.3";
 static const char *DESCRIPTION    = trNOOP("Automatically record live TV");
 
 static const char *MenuEntry_EnablePlugin = "EnablePlugin";
 static const char *MenuEntry_MaxLength = "MaxTimeshiftLength";
+static const char *MenuEntry_MinFreeSpace = "MinFreeDiskSpace";
+static const char *MenuEntry_DeleteRate = "DeleteRate";
+static const char *MenuEntry_SkipNetworkDisk = "SkipNetworkVideoDir";
+static const char *MenuEntry_InactivityTimeout = "InactivityTimeout";
+static const char *MenuEntry_PrefetchSeconds = "PrefetchSeconds";
+static const char *MenuEntry_AnalyzeStream = "AnalyzeStream";
+static const char *MenuEntry_StallTimeout = "StallTimeout";
+static const char *MenuEntry_KeepOnRestart = "KeepOnRestart";
+static const char *MenuEntry_PauseForRecordings = "PauseForRecordings";
 
 
 bool g_enablePlugin = true;
 int g_maxLength = 3;
+int g_minFreeSpace = 0; // GB, 0 = don't check
+int g_deleteRate = 0; // MB/s, 0 = unlimited
+bool g_skipNetworkDisk = false;
+int g_inactivityTimeout = 0; // minutes, 0 = only when VDR considers the user inactive
+int g_prefetchSeconds = 0; // 0 = no prefetching
+bool g_analyzeStream = false;
+int g_stallTimeout = 0; // seconds, 0 = don't watch the recording
+bool g_keepOnRestart = false;
+bool g_pauseForRecordings = false;
 
 
 class cPluginPermashift;
@@ -34,6 +75,15 @@ class cMenuSetupLR : public cMenuSetupPage
 private:
 	int newEnablePlugin;
 	int newMaxLength;
+	int newMinFreeSpace;
+	int newDeleteRate;
+	int newSkipNetworkDisk;
+	int newInactivityTimeout;
+	int newPrefetchSeconds;
+	int newAnalyzeStream;
+	int newStallTimeout;
+	int newKeepOnRestart;
+	int newPauseForRecordings;
 
 protected:
 	virtual void Store(void);
@@ -64,6 +114,8 @@ protected:
 
 	virtual void Recording(const cDevice *Device, const char *Name, const char *FileName, bool On);
 
+	virtual void Replaying(const cControl *Control, const char *Name, const char *FileName, bool On);
+
 };
 
 
@@ -72,10 +124,20 @@ class cPluginPermashift : public cPlugin
 private:
 	// our status monitor
 	LRStatusMonitor *m_statusMonitor;
+	// removes our deleted recordings in the background
+	cPermashiftRemover m_remover;
+	// reads ahead when rewinding in our recording
+	cPermashiftPrefetcher m_prefetcher;
+	// device our recording is running on
+	cDevice* m_recordingDevice;
+	// stream statistics of our recording
+	cPermashiftAnalyzer* m_analyzer;
+	// watches the recorder writing our recording, NULL = nobody
+	cPermashiftWatchdog* m_watchdog;
 	// the timer we created for live recording
 	cTimer* m_liveTimer;
 	// store file name used for our recording for timeout recognition
-	const char* m_fileName;
+	char* m_fileName;
 	// we're just starting a recording (needed for callbacks)
 	bool m_startingRecording;
 	// we're just stopping a recording (needed for callbacks)
@@ -83,6 +145,62 @@ private:
 
 	int m_mainThreadCounter;
 
+	// when the user switched away from the last channel, 0 = not zapping
+	uint64_t m_zapStart;
+	// where to write our statistics, NULL = nowhere
+	char* m_metricsFile;
+	// channel and start of our current recording
+	int m_channelNumber;
+	time_t m_recordingStart;
+	// when we started or continued recording, for the inactivity timeout
+	time_t m_activeSince;
+	// the same for other plugins
+	cBufferSnapshot m_snapshot;
+	// last index growth seen by CheckStall() and since when data has kept arriving
+	time_t m_indexGrowth;
+	time_t m_arrivingSince;
+	unsigned int m_stallPackets;
+	time_t m_lastStallCheck;
+	// we've warned about the current stall
+	bool m_stalled;
+	// we've logged that the video disks are running full
+	bool m_lowSpace;
+	// we don't record because another timer is recording
+	bool m_pausedForRecording;
+	// recording kept from the last run, NULL = none
+	char* m_journalFile;
+	tChannelID m_journalChannel;
+	time_t m_journalTimerStart;
+
+	// delete a recording of ours and hand it to the remover
+	bool DeleteRecording(const char* fileName);
+
+	// detach the stream analyzer and log its results
+	void StopAnalyzer(void);
+
+	// one line about our current recording for SVDRP
+	cString BufferStatus(void);
+
+	// our timer still exists and has been raised above pause priority/lifetime
+	bool IsPromoted(void);
+
+	// attach the analyzer and the watchdog to our new recording
+	void StartWatching(void);
+	// let go of the watchdog without waiting for it
+	void StopWatchdog(void);
+	// warn if the recorder hasn't written for a while although data arrives
+	void CheckStall(void);
+
+	// keep our recording over a restart of VDR
+	bool SaveJournal(void);
+	bool LoadJournal(void);
+	// continue the kept recording if we're back on its channel,
+	// otherwise delete it; returns true if it's continued
+	bool ResumeFromJournal(int channelNumber);
+
+	// publish the state of our recording to Service() callers
+	void UpdateSnapshot(void) { m_snapshot.Set(m_liveTimer != NULL, m_channelNumber, m_recordingStart, m_fileName); };
+
 public:
 	cPluginPermashift(void);
 	virtual ~cPluginPermashift();
@@ -97,6 +215,7 @@ public:
 	void ChannelSwitch(const cDevice *device, int channelNumber, bool liveView);
 	void TimerChange(const cTimer *Timer, eTimerChange Change);
 	void Recording(const cDevice *Device, const char *Name, const char *FileName, bool On);
+	void Replaying(const cControl *Control, const char *Name, const char *FileName, bool On);
 
 	// Option: enabling plugin
 	void SetEnable(bool enable) { g_enablePlugin = enable; };
@@ -109,14 +228,23 @@ public:
 	virtual const char *Version(void) { return VERSION; }
 	virtual const char *Description(void) { return tr(DESCRIPTION); }
 	virtual const char *CommandLineHelp(void);
+	virtual bool ProcessArgs(int argc, char *argv[]);
 	virtual cMenuSetupPage *SetupMenu(void);
 	virtual bool SetupParse(const char *Name, const char *Value);
+	virtual bool Service(const char *Id, void *Data = NULL);
+	virtual const char **SVDRPHelpPages(void);
+	virtual cString SVDRPCommand(const char *Command, const char *Option, int &ReplyCode);
 };
 
 cPluginPermashift::cPluginPermashift(void) : 
-	m_statusMonitor(NULL), m_liveTimer(NULL), m_fileName(NULL),
+	m_statusMonitor(NULL), m_recordingDevice(NULL), m_analyzer(NULL), m_watchdog(NULL),
+	m_liveTimer(NULL), m_fileName(NULL),
 	m_startingRecording(false), m_stoppingRecording(false),
-	m_mainThreadCounter(0)
+	m_mainThreadCounter(0), m_zapStart(0), m_metricsFile(NULL),
+	m_channelNumber(0), m_recordingStart(0), m_activeSince(0),
+	m_indexGrowth(0), m_arrivingSince(0), m_stallPackets(0), m_lastStallCheck(0), m_stalled(false),
+	m_lowSpace(false), m_pausedForRecording(false),
+	m_journalFile(NULL), m_journalTimerStart(0)
 {
 	g_enablePlugin = true;
 	g_maxLength = Setup.InstantRecordTime / 60;
@@ -124,35 +252,119 @@ cPluginPermashift::cPluginPermashift(void) :
 
 cPluginPermashift::~cPluginPermashift()
 {
-	delete m_fileName;
+	free(m_fileName);
+	free(m_metricsFile);
+	free(m_journalFile);
+	delete m_analyzer;
 	delete m_statusMonitor;
 }
 
 bool cPluginPermashift::Start(void)
 {
 	m_statusMonitor = new LRStatusMonitor(this);
+	g_flightRecorder.SetDirectory(ConfigDirectory(Name()));
+	LoadJournal();
 	return true;
 }
 
 void cPluginPermashift::Stop(void)
 {
-	// stop last recording
-	StopLiveRecording();
+	// no background removal while shutting down, VDR will remove the rest
+	m_remover.Stop();
+	StopWatchdog();
+
+	// stop last recording, unless we keep it for the next start
+	if (!g_keepOnRestart || !SaveJournal())
+	{
+		StopLiveRecording();
+	}
+	StopAnalyzer();
 	
 	// we probably deleted a timer, so we save the Timers
 	// (which isn't done by the main program after this point)
 	Timers.Save();
+
+	m_prefetcher.Stop();
+
+	if (m_metricsFile)
+	{
+		g_statistics.Save(m_metricsFile);
+	}
+}
+
+// a timer other than the given one is recording
+static bool OtherTimerRecording(const cTimer* timer)
+{
+	for (cTimer* ti = Timers.First(); ti != NULL; ti = Timers.Next(ti))
+	{
+		if (ti != timer && ti->Recording())
+		{
+			return true;
+		}
+	}
+	return false;
 }
 
 void cPluginPermashift::MainThreadHook(void)
 {
+	// catches all the ways our timer may have gone
+	UpdateSnapshot();
+
+	// make way for other recordings, and come back when they're done
+	if (g_pauseForRecordings && g_enablePlugin)
+	{
+		if (m_liveTimer != NULL && OtherTimerRecording(m_liveTimer))
+		{
+			isyslog("Permashift: Another timer is recording, stopping recording.");
+			StopLiveRecording();
+			m_pausedForRecording = true;
+		}
+		else if (m_pausedForRecording && m_liveTimer == NULL && !OtherTimerRecording(NULL))
+		{
+			m_pausedForRecording = false;
+			if (cDevice::CurrentChannel() > 0)
+			{
+				isyslog("Permashift: No other timer is recording anymore, starting recording.");
+				StartLiveRecording(cDevice::CurrentChannel());
+			}
+		}
+	}
+
+	if (g_stallTimeout > 0 && m_liveTimer != NULL)
+	{
+		CheckStall();
+	}
+
+	// tell the prefetcher where replay of our recording is
+	if (m_prefetcher.Active())
+	{
+		cControl* control = cControl::Control();
+		int current, total;
+		bool play, forward;
+		int speed;
+		if (control && control->GetIndex(current, total) && control->GetReplayMode(play, forward, speed))
+		{
+			m_prefetcher.SetPosition(current, forward);
+		}
+	}
+
 	// This hook is supposed to be called about once a second,
 	// so let's do our checks about once a minute.
 	if (m_mainThreadCounter++ >= 60)
 	{
 		if (m_liveTimer != NULL)
 		{
-			if (ShutdownHandler.IsUserInactive())
+			// VDR only tracks inactivity if automatic shutdown is configured,
+			// so we can have our own timeout to let the disk spin down.
+			bool inactive = ShutdownHandler.IsUserInactive();
+			if (!inactive && g_inactivityTimeout > 0)
+			{
+				// No key pressed yet counts from when we started recording. A
+				// continued recording is older, but the user just got here.
+				time_t lastActivity = max(cRemote::LastActivity(), m_activeSince);
+				inactive = time(NULL) - lastActivity >= g_inactivityTimeout * 60;
+			}
+			if (inactive)
 			{
 				if (Interface->Confirm(tr("Press key to continue permanent timeshift"), EXPIRECANCELPROMPT, true))
 				{
@@ -160,6 +372,12 @@ void cPluginPermashift::MainThreadHook(void)
 				}
 			}
 		}
+		g_statistics.Set(gaTimers, Timers.Count());
+		g_statistics.Set(gaRecordings, Recordings.Count());
+		if (m_metricsFile && !g_statistics.Save(m_metricsFile))
+		{
+			esyslog("Permashift: Could not write statistics to %s!", m_metricsFile);
+		}
 		m_mainThreadCounter = 0;
 	}
 }
@@ -170,15 +388,134 @@ void cPluginPermashift::ChannelSwitch(const cDevice *device, int channelNumber,
 	{
 		if (channelNumber > 0)
 		{
-			StartLiveRecording(channelNumber);
+			if (!ResumeFromJournal(channelNumber))
+			{
+				StartLiveRecording(channelNumber);
+			}
+			if (m_zapStart)
+			{
+				uint64_t duration = g_statistics.AddTime(stZap, m_zapStart);
+				g_flightRecorder.Add(feZapEnd, channelNumber, m_liveTimer, true, duration);
+				m_zapStart = 0;
+			}
+			PERMASHIFT_PROBE1(zap_end, channelNumber);
 		}
 		else
 		{
+			PERMASHIFT_PROBE1(zap_start, m_channelNumber);
+			g_statistics.Count(ctZaps);
+			g_flightRecorder.Add(feZapStart, m_channelNumber, m_liveTimer);
+			m_zapStart = cPermashiftStatistics::Now();
 			StopLiveRecording();
 		}
 	}
 }
 
+void cPluginPermashift::StartWatching(void)
+{
+	StopAnalyzer();
+	StopWatchdog();
+	m_indexGrowth = 0;
+	m_arrivingSince = 0;
+	m_stallPackets = 0;
+	m_stalled = false;
+
+	// watch the stream next to the recorder, the stall check needs it as well
+	cChannel *channel = Channels.GetByNumber(m_channelNumber);
+	if ((g_analyzeStream || g_stallTimeout > 0) && m_recordingDevice && channel)
+	{
+		m_analyzer = new cPermashiftAnalyzer(channel);
+		if (!m_recordingDevice->AttachReceiver(m_analyzer))
+		{
+			DELETENULL(m_analyzer);
+		}
+	}
+	if (g_stallTimeout > 0 && m_analyzer && m_fileName)
+	{
+		m_watchdog = cPermashiftWatchdog::Start(m_fileName);
+	}
+}
+
+void cPluginPermashift::StopWatchdog(void)
+{
+	if (m_watchdog)
+	{
+		m_watchdog->Stop();
+		m_watchdog = NULL;
+	}
+}
+
+void cPluginPermashift::CheckStall(void)
+{
+	time_t now = time(NULL);
+	if (now == m_lastStallCheck || m_analyzer == NULL || m_watchdog == NULL)
+	{
+		return;
+	}
+	m_lastStallCheck = now;
+
+	// the recorder stops on its own at the end of the timer
+	if (now >= m_liveTimer->StopTime())
+	{
+		return;
+	}
+
+	// Only packets we can look into count as data for the recorder: without
+	// reception, or scrambled without a CAM, there's nothing to write.
+	// Receive() counts in the device's thread, a value a moment old is fine.
+	unsigned int packets, ccErrors, teiErrors, scrambled;
+	m_analyzer->Totals(packets, ccErrors, teiErrors, scrambled);
+	unsigned int clear = packets - scrambled;
+	if (clear == m_stallPackets)
+	{
+		m_arrivingSince = 0;
+		return;
+	}
+	m_stallPackets = clear;
+	if (m_arrivingSince == 0)
+	{
+		m_arrivingSince = now;
+	}
+
+	time_t growth = m_watchdog->LastGrowth();
+	if (growth != m_indexGrowth)
+	{
+		m_indexGrowth = growth;
+		m_stalled = false;
+	}
+	int seconds = int(now - max(growth, m_arrivingSince));
+	if (m_stalled || seconds < g_stallTimeout)
+	{
+		return;
+	}
+
+	// We only warn: the recording may still be needed, and if the disk is
+	// hanging, deleting it would hang as well.
+	m_stalled = true;
+	esyslog("Permashift: Recording hasn't been written for %d seconds while the stream is received.", int(now - growth));
+	g_statistics.Count(ctStalls);
+	g_flightRecorder.Add(feStall, m_channelNumber, m_liveTimer, false, uint64_t(now - growth) * 1000000);
+	g_flightRecorder.DumpOnError();
+}
+
+static bool IsNetworkFileSystem(const char* path)
+{
+	struct statfs st;
+	if (statfs(path, &st) != 0)
+	{
+		return false;
+	}
+	switch ((unsigned int)st.f_type)
+	{
+		case NFS_SUPER_MAGIC:
+		case SMB_SUPER_MAGIC:
+		case CIFS_MAGIC_NUMBER:
+		case SMB2_MAGIC_NUMBER:
+			return true;
+	}
+	return false;
+}
+
 bool cPluginPermashift::StartLiveRecording(int channelNumber)
 {
 	if (!g_enablePlugin) return true;
@@ -190,10 +527,67 @@ bool cPluginPermashift::StartLiveRecording(int channelNumber)
 		return false;
 	}
 
+	// Writing a permanent recording over the network is expensive,
+	// so diskless clients may want to do without.
+	if (g_skipNetworkDisk && IsNetworkFileSystem(VideoDirectory))
+	{
+		dsyslog("Permashift: Video directory is on a network file system, not starting recording.");
+		return false;
+	}
+
+	// Placement across video directories is done by VDR (the one with the most
+	// free space wins), so we can't keep our writes off the disk of a running
+	// recording. But we can stay out of the way while other timers record.
+	if (g_pauseForRecordings && OtherTimerRecording(NULL))
+	{
+		if (!m_pausedForRecording)
+		{
+			isyslog("Permashift: Another timer is recording, not starting recording.");
+			m_pausedForRecording = true;
+		}
+		return false;
+	}
+	m_pausedForRecording = false;
+
+	// leave the rest of the space to real recordings
+	if (g_minFreeSpace > 0)
+	{
+		int freeMB = 0;
+		VideoDiskSpace(&freeMB);
+		if (freeMB < g_minFreeSpace * 1024)
+		{
+			if (!m_lowSpace)
+			{
+				isyslog("Permashift: Only %d MB free on video disks, not starting recording.", freeMB);
+				m_lowSpace = true;
+			}
+			return false;
+		}
+		m_lowSpace = false;
+	}
+
 	// Start recording
+	m_recordingDevice = NULL;
 	m_startingRecording = true;
-	cRecordControls::Start(NULL, true);
+	uint64_t startTime = cPermashiftStatistics::Now();
+	PERMASHIFT_PROBE1(recording_start, channelNumber);
+	bool started = cRecordControls::Start(NULL, true);
+	PERMASHIFT_PROBE2(recording_started, channelNumber, started);
+	uint64_t duration = g_statistics.AddTime(stStart, startTime);
 	m_startingRecording = false;
+	g_statistics.Count(started ? ctStarts : ctStartFailures);
+	g_flightRecorder.Add(feRecordingStart, channelNumber, m_liveTimer, started, duration);
+	if (!started)
+	{
+		g_flightRecorder.DumpOnError();
+	}
+	if (started)
+	{
+		m_channelNumber = channelNumber;
+		m_recordingStart = m_activeSince = time(NULL);
+		StartWatching();
+	}
+	UpdateSnapshot();
 
 	return true;
 }
@@ -209,6 +603,7 @@ bool cPluginPermashift::StopLiveRecording()
 
 	// First check if our pointer is still valid.
 	// This should always be the case.
+	uint64_t validateTime = cPermashiftStatistics::Now();
 	bool isValid = false;
 	for (cTimer* ti = Timers.First(); ti != NULL; ti = Timers.Next(ti))
 	{
@@ -218,9 +613,12 @@ bool cPluginPermashift::StopLiveRecording()
 			break;
 		}
 	}
+	g_statistics.AddTime(stValidate, validateTime);
 	if (!isValid)
 	{
 		esyslog("Permashift: Plugin's timer is gone!");
+		g_flightRecorder.Add(feTimerGone, m_channelNumber, m_liveTimer, false);
+		g_flightRecorder.DumpOnError();
 		m_liveTimer = NULL;
 		return false;
 	}
@@ -229,6 +627,8 @@ bool cPluginPermashift::StopLiveRecording()
 	// We are setting TRANSFERPRIORITY - 1, but we delete our own recordings up to PausePriority.
 	if (m_liveTimer->Priority() > Setup.PausePriority || m_liveTimer->Lifetime() > Setup.PauseLifetime)
 	{
+		g_flightRecorder.Add(fePromoted, m_channelNumber, m_liveTimer);
+		StopWatchdog();
 		m_liveTimer = NULL;
 		return true;
 	}
@@ -245,11 +645,20 @@ bool cPluginPermashift::StopLiveRecording()
 	// we're going to stop & delete
 	m_stoppingRecording = true;
 
+	StopAnalyzer();
+	StopWatchdog();
+
 	// mark the timer to be stopped
 	m_liveTimer->Skip();
 
 	// process, so the recording is actually stopped
+	uint64_t processTime = cPermashiftStatistics::Now();
+	PERMASHIFT_PROBE1(recording_stop, m_channelNumber);
 	cRecordControls::Process(time(NULL));
+	PERMASHIFT_PROBE1(recording_stopped, m_channelNumber);
+	uint64_t duration = g_statistics.AddTime(stProcess, processTime);
+	g_statistics.Count(ctStops);
+	g_flightRecorder.Add(feRecordingStop, m_channelNumber, m_liveTimer, true, duration);
 
 	// delete the timer
 	Timers.Del(m_liveTimer);
@@ -258,41 +667,235 @@ bool cPluginPermashift::StopLiveRecording()
 	// delete the recording and its file
 	if (fileName)
 	{
-		cRecording *recording = Recordings.GetByName(fileName);
-		if (recording)
+		DeleteRecording(fileName);
+	}
+
+	m_stoppingRecording = false;
+
+	m_liveTimer = NULL;
+	UpdateSnapshot();
+	free(fileName);
+
+	return true;
+}
+
+bool cPluginPermashift::DeleteRecording(const char* fileName)
+{
+	uint64_t deleteTime = cPermashiftStatistics::Now();
+	PERMASHIFT_PROBE1(delete_begin, fileName);
+	cRecording *recording = Recordings.GetByName(fileName);
+	if (recording == NULL)
+	{
+		esyslog("Permashift: Did not find recording to delete!");
+		g_statistics.Count(ctDeleteFailures);
+		g_flightRecorder.Add(feDelete, m_channelNumber, NULL, false);
+		g_flightRecorder.DumpOnError();
+		PERMASHIFT_PROBE2(delete_end, fileName, false);
+		return false;
+	}
+	if (!recording->Delete())
+	{
+		esyslog("Permashift: Deleting recording failed!");
+		g_statistics.Count(ctDeleteFailures);
+		g_flightRecorder.Add(feDelete, m_channelNumber, NULL, false);
+		g_flightRecorder.DumpOnError();
+		PERMASHIFT_PROBE2(delete_end, fileName, false);
+		return false;
+	}
+	Recordings.DelByName(fileName);
+	PERMASHIFT_PROBE2(delete_end, fileName, true);
+	uint64_t duration = g_statistics.AddTime(stDelete, deleteTime);
+	g_statistics.Count(ctDeletes);
+	g_flightRecorder.Add(feDelete, m_channelNumber, NULL, true, duration);
+
+	// Delete() renamed the directory from ".rec" to ".del"
+	char* deletedName = strdup(fileName);
+	char* ext = strrchr(deletedName, '.');
+	if (ext && !strcmp(ext, ".rec"))
+	{
+		strcpy(ext, ".del");
+		m_remover.SetRate(g_deleteRate);
+		m_remover.Remove(deletedName);
+	}
+	free(deletedName);
+
+	return true;
+}
+
+bool cPluginPermashift::SaveJournal(void)
+{
+	if (!g_enablePlugin || m_liveTimer == NULL || m_fileName == NULL)
+	{
+		return false;
+	}
+	// promoted recordings aren't ours anymore
+	if (m_liveTimer->Priority() > Setup.PausePriority || m_liveTimer->Lifetime() > Setup.PauseLifetime)
+	{
+		return false;
+	}
+	bool isValid = false;
+	for (cTimer* ti = Timers.First(); ti != NULL; ti = Timers.Next(ti))
+	{
+		if (ti == m_liveTimer)
 		{
-			if (recording->Delete())
-			{
-				Recordings.DelByName(fileName);
-			}
-			else
-			{
-				esyslog("Permashift: Deleting recording failed!");
-			}
+			isValid = true;
+			break;
 		}
-		else
+	}
+	if (!isValid || m_liveTimer->Channel() == NULL)
+	{
+		return false;
+	}
+
+	// The timer itself is saved with the other timers. After the restart
+	// VDR continues the recording in the same directory.
+	cSafeFile f(AddDirectory(ConfigDirectory(Name()), JOURNALFILE));
+	if (!f.Open())
+	{
+		return false;
+	}
+	fprintf(f, "channel=%s\n", *m_liveTimer->Channel()->GetChannelID().ToString());
+	fprintf(f, "timer=%ld\n", long(m_liveTimer->StartTime()));
+	fprintf(f, "file=%s\n", m_fileName);
+	if (!f.Close())
+	{
+		return false;
+	}
+	isyslog("Permashift: Keeping recording %s for the next start", m_fileName);
+	return true;
+}
+
+bool cPluginPermashift::LoadJournal(void)
+{
+	cString journal = AddDirectory(ConfigDirectory(Name()), JOURNALFILE);
+	FILE* f = fopen(journal, "r");
+	if (f == NULL)
+	{
+		return false;
+	}
+	cReadLine reader;
+	char* line;
+	while ((line = reader.Read(f)) != NULL)
+	{
+		char* value = strchr(line, '=');
+		if (value == NULL)
 		{
-			esyslog("Permashift: Did not find recording to delete!");
+			continue;
+		}
+		*value++ = 0;
+		if (!strcmp(line, "channel"))
+		{
+			m_journalChannel = tChannelID::FromString(value);
+		}
+		else if (!strcmp(line, "timer"))
+		{
+			m_journalTimerStart = atol(value);
+		}
+		else if (!strcmp(line, "file"))
+		{
+			free(m_journalFile);
+			m_journalFile = strdup(value);
 		}
 	}
+	fclose(f);
 
-	m_stoppingRecording = false;
+	// only used once, whatever happens next
+	unlink(journal);
+	return m_journalFile != NULL;
+}
 
-	m_liveTimer = NULL;
-	delete fileName;
+bool cPluginPermashift::ResumeFromJournal(int channelNumber)
+{
+	if (m_journalFile == NULL)
+	{
+		return false;
+	}
+	char* fileName = m_journalFile;
+	m_journalFile = NULL;
 
-	return true;
+	cTimer* timer = NULL;
+	for (cTimer* ti = Timers.First(); ti != NULL; ti = Timers.Next(ti))
+	{
+		if (ti->StartTime() == m_journalTimerStart && ti->Channel() && ti->Channel()->GetChannelID() == m_journalChannel)
+		{
+			timer = ti;
+			break;
+		}
+	}
+	cChannel* channel = Channels.GetByNumber(channelNumber);
+	bool resume = g_enablePlugin && timer && channel && channel->GetChannelID() == m_journalChannel;
+
+	// VDR may have started the timer already
+	if (resume && cRecordControls::GetRecordControl(timer) == NULL)
+	{
+		m_startingRecording = true;
+		resume = cRecordControls::Start(timer);
+		m_startingRecording = false;
+		if (!resume)
+		{
+			esyslog("Permashift: Continuing recording %s failed!", fileName);
+		}
+	}
+
+	if (resume)
+	{
+		m_liveTimer = timer;
+		m_channelNumber = channelNumber;
+		free(m_fileName);
+		m_fileName = strdup(fileName);
+		// if VDR started the timer, Recording(On) didn't tell us the device
+		cRecordControl* control = cRecordControls::GetRecordControl(timer);
+		m_recordingDevice = control ? control->Device() : NULL;
+
+		// Rewinding covers what the recording holds, not the time VDR was
+		// down, so its start is counted back from its length.
+		cRecording* recording = Recordings.GetByName(fileName);
+		double framesPerSecond = recording ? recording->FramesPerSecond() : DEFAULTFRAMESPERSECOND;
+		cIndexFile index(fileName, false);
+		m_recordingStart = time(NULL) - time_t((index.Last() + 1) / framesPerSecond);
+		m_activeSince = time(NULL);
+
+		StartWatching();
+		isyslog("Permashift: Continuing recording %s", fileName);
+		UpdateSnapshot();
+	}
+	else
+	{
+		// we're on another channel now, so the old recording is of no use
+		if (timer)
+		{
+			m_stoppingRecording = true;
+			if (cRecordControls::GetRecordControl(timer))
+			{
+				timer->Skip();
+				cRecordControls::Process(time(NULL));
+			}
+			Timers.Del(timer);
+			Timers.SetModified();
+			m_stoppingRecording = false;
+		}
+		if (Recordings.GetByName(fileName))
+		{
+			DeleteRecording(fileName);
+		}
+	}
+
+	free(fileName);
+	return resume;
 }
 
 void cPluginPermashift::TimerChange(const cTimer *Timer, eTimerChange Change)
 {
 	if (Timer == NULL) return;
 
+	PERMASHIFT_PROBE2(timer_change, Timer, Change);
+
 	if (Change == tcAdd)
 	{
 		// fetch timer of our recording
 		if (m_startingRecording)
 		{
+			g_flightRecorder.Add(feTimerAdd, 0, Timer);
 			// I know it'as ugly, but we need a non-const timer...
 			m_liveTimer = const_cast<cTimer*>(Timer);
 			// let's have a low priority, so we're not getting into the way of anyone claiming the receiver
@@ -312,18 +915,13 @@ void cPluginPermashift::TimerChange(const cTimer *Timer, eTimerChange Change)
 		// when our timer is deleted from outside, delete the file as well
 		if (!m_stoppingRecording && Timer == m_liveTimer)
 		{
+			g_flightRecorder.Add(feTimerDel, m_channelNumber, Timer);
 			if (Timer->IsSingleEvent() && !Timer->Recording() && Timer->StopTime() <= time(NULL))
 			{
-				cRecording *recording = Recordings.GetByName(m_fileName);
-				if (recording)
-				{
-					if (recording->Delete())
-					{
-						Recordings.DelByName(m_fileName);
-					}
-				}
+				DeleteRecording(m_fileName);
 			}
 			m_liveTimer = NULL;
+			UpdateSnapshot();
 		}
 	}
 }
@@ -335,16 +933,79 @@ void cPluginPermashift::Recording(const cDevice *Device, const char *Name, const
 	{
 		if (m_startingRecording)
 		{
-			delete m_fileName;
+			free(m_fileName);
 			m_fileName = strdup(FileName);
+			m_recordingDevice = const_cast<cDevice*>(Device);
 		}
 	}
+	else if (FileName && m_fileName && !strcmp(FileName, m_fileName))
+	{
+		StopAnalyzer();
+		StopWatchdog();
+	}
+}
+
+void cPluginPermashift::StopAnalyzer(void)
+{
+	if (m_analyzer)
+	{
+		// no more Receive() calls while we read the counters
+		m_analyzer->Detach();
+		// it may only be there for the stall check
+		if (g_analyzeStream)
+		{
+			m_analyzer->LogSummary();
+		}
+		DELETENULL(m_analyzer);
+	}
+}
+
+void cPluginPermashift::Replaying(const cControl *Control, const char *Name, const char *FileName, bool On)
+{
+	if (On)
+	{
+		// only care about our own recording
+		if (g_prefetchSeconds > 0 && FileName && m_fileName && !strcmp(FileName, m_fileName))
+		{
+			cRecording *recording = Recordings.GetByName(FileName);
+			m_prefetcher.Start(FileName, recording ? recording->FramesPerSecond() : DEFAULTFRAMESPERSECOND, g_prefetchSeconds);
+		}
+	}
+	else
+	{
+		m_prefetcher.Stop();
+	}
 }
 
 const char *cPluginPermashift::CommandLineHelp(void)
 {
 	// Return a string that describes all known command line options.
-	return NULL;
+	return "  -m FILE,  --metrics=FILE write statistics to FILE once a minute\n"
+	       "                           (Prometheus text format)\n";
+}
+
+bool cPluginPermashift::ProcessArgs(int argc, char *argv[])
+{
+	static struct option long_options[] =
+	{
+		{ "metrics", required_argument, NULL, 'm' },
+		{ NULL, no_argument, NULL, 0 }
+	};
+
+	int c;
+	while ((c = getopt_long(argc, argv, "m:", long_options, NULL)) != -1)
+	{
+		switch (c)
+		{
+			case 'm':
+				free(m_metricsFile);
+				m_metricsFile = strdup(optarg);
+				break;
+			default:
+				return false;
+		}
+	}
+	return true;
 }
 
 cMenuSetupPage *cPluginPermashift::SetupMenu(void)
@@ -352,6 +1013,178 @@ cMenuSetupPage *cPluginPermashift::SetupMenu(void)
 	return new cMenuSetupLR();
 }
 
+// SVDRP replies must not end with a newline
+static cString StripNewline(const char* text)
+{
+	char* s = strdup(text);
+	int len = strlen(s);
+	while (len > 0 && s[len - 1] == '\n')
+	{
+		s[--len] = 0;
+	}
+	return cString(s, true);
+}
+
+bool cPluginPermashift::IsPromoted(void)
+{
+	if (m_liveTimer == NULL)
+	{
+		return false;
+	}
+	for (cTimer* ti = Timers.First(); ti != NULL; ti = Timers.Next(ti))
+	{
+		if (ti == m_liveTimer)
+		{
+			return m_liveTimer->Priority() > Setup.PausePriority || m_liveTimer->Lifetime() > Setup.PauseLifetime;
+		}
+	}
+	return false;
+}
+
+cString cPluginPermashift::BufferStatus(void)
+{
+	// only our own state, so we don't have to lock Timers or Recordings
+	if (m_liveTimer == NULL || m_fileName == NULL)
+	{
+		return NULL;
+	}
+	cChannel *channel = Channels.GetByNumber(m_channelNumber);
+	int seconds = max(1, int(time(NULL) - m_recordingStart));
+	off_t size = DirectorySize(m_fileName);
+	int freeMB = 0;
+	VideoDiskSpace(&freeMB);
+	return cString::sprintf("%d %s, %d min, %lld MB, %.1f Mbit/s, %d MB free, %s",
+		m_channelNumber, channel ? channel->Name() : "?", seconds / 60,
+		(long long)(size / MEGABYTE(1)), double(size) * 8 / seconds / 1000000,
+		freeMB, m_fileName);
+}
+
+bool cPluginPermashift::Service(const char *Id, void *Data)
+{
+	if (!strcmp(Id, PERMASHIFT_BUFFERINFO_V1_0))
+	{
+		if (Data)
+		{
+			m_snapshot.Get((Permashift_BufferInfo_v1_0*)Data);
+		}
+		return true;
+	}
+	return false;
+}
+
+const char **cPluginPermashift::SVDRPHelpPages(void)
+{
+	static const char *HelpPages[] =
+	{
+		"LSTB\n"
+		"    List the current timeshift recording: channel, length, size,\n"
+		"    bitrate, free disk space and directory.",
+		"STAT\n"
+		"    Show counters and latencies of channel switches and recordings.",
+		"METR\n"
+		"    Show all counters and histograms in Prometheus text format.",
+		"FLTR\n"
+		"    Write the recent history of the plugin's decisions to\n"
+		"    flightrecorder.bin in the plugin's configuration directory.",
+		"STOP\n"
+		"    Stop and delete the current timeshift recording now.\n"
+		"    A recording that has been kept is neither stopped nor deleted.",
+		"KEEP\n"
+		"    Raise the priority and lifetime of the current timeshift\n"
+		"    recording's timer, so the plugin doesn't delete the recording\n"
+		"    at the next channel switch. The recording's info file keeps the\n"
+		"    pause priority and lifetime, so VDR may still delete it like\n"
+		"    any other paused recording.",
+		"ENAB\n"
+		"    Enable the plugin and start recording the current channel.",
+		"DISA\n"
+		"    Stop the current timeshift recording and disable the plugin.",
+		NULL
+	};
+	return HelpPages;
+}
+
+cString cPluginPermashift::SVDRPCommand(const char *Command, const char *Option, int &ReplyCode)
+{
+	if (!strcasecmp(Command, "LSTB"))
+	{
+		cString status = BufferStatus();
+		if (*status == NULL)
+		{
+			ReplyCode = 550;
+			return "No timeshift recording";
+		}
+		return status;
+	}
+	if (!strcasecmp(Command, "STAT"))
+	{
+		return StripNewline(g_statistics.Summary());
+	}
+	if (!strcasecmp(Command, "METR"))
+	{
+		return StripNewline(g_statistics.ToText());
+	}
+	if (!strcasecmp(Command, "FLTR"))
+	{
+		cString fileName = g_flightRecorder.Dump();
+		if (*fileName == NULL)
+		{
+			ReplyCode = 554;
+			return "Writing flight recorder failed";
+		}
+		return fileName;
+	}
+	if (!strcasecmp(Command, "STOP"))
+	{
+		if (m_liveTimer == NULL)
+		{
+			ReplyCode = 550;
+			return "No timeshift recording";
+		}
+		if (IsPromoted())
+		{
+			ReplyCode = 550;
+			return "Timeshift recording has been kept, not stopped";
+		}
+		if (!StopLiveRecording())
+		{
+			ReplyCode = 554;
+			return "Stopping timeshift recording failed";
+		}
+		return "Timeshift recording stopped";
+	}
+	if (!strcasecmp(Command, "KEEP"))
+	{
+		if (m_liveTimer == NULL)
+		{
+			ReplyCode = 550;
+			return "No timeshift recording";
+		}
+		// StopLiveRecording() leaves recordings above pause priority/lifetime alone
+		m_liveTimer->SetPriority(min(MAXPRIORITY, max(Setup.DefaultPriority, Setup.PausePriority + 1)));
+		m_liveTimer->SetLifetime(min(MAXLIFETIME, max(Setup.DefaultLifetime, Setup.PauseLifetime + 1)));
+		Timers.SetModified();
+		g_flightRecorder.Add(fePromoted, m_channelNumber, m_liveTimer);
+		return "Timeshift recording will be kept";
+	}
+	if (!strcasecmp(Command, "ENAB"))
+	{
+		g_enablePlugin = true;
+		if (m_liveTimer == NULL && cDevice::CurrentChannel() > 0)
+		{
+			StartLiveRecording(cDevice::CurrentChannel());
+		}
+		return "Plugin enabled";
+	}
+	if (!strcasecmp(Command, "DISA"))
+	{
+		StopLiveRecording();
+		g_enablePlugin = false;
+		return "Plugin disabled";
+	}
+	return NULL;
+}
+
 bool cPluginPermashift::SetupParse(const char *Name, const char *Value)
 {
 	if (!strcmp(Name, MenuEntry_EnablePlugin))
@@ -364,6 +1197,51 @@ bool cPluginPermashift::SetupParse(const char *Name, const char *Value)
 		g_maxLength = atoi(Value);
 		return true;
 	}
+	if (!strcmp(Name, MenuEntry_MinFreeSpace))
+	{
+		g_minFreeSpace = atoi(Value);
+		return true;
+	}
+	if (!strcmp(Name, MenuEntry_DeleteRate))
+	{
+		g_deleteRate = atoi(Value);
+		return true;
+	}
+	if (!strcmp(Name, MenuEntry_SkipNetworkDisk))
+	{
+		g_skipNetworkDisk = (0 == strcmp(Value, "1"));
+		return true;
+	}
+	if (!strcmp(Name, MenuEntry_InactivityTimeout))
+	{
+		g_inactivityTimeout = atoi(Value);
+		return true;
+	}
+	if (!strcmp(Name, MenuEntry_PrefetchSeconds))
+	{
+		g_prefetchSeconds = atoi(Value);
+		return true;
+	}
+	if (!strcmp(Name, MenuEntry_AnalyzeStream))
+	{
+		g_analyzeStream = (0 == strcmp(Value, "1"));
+		return true;
+	}
+	if (!strcmp(Name, MenuEntry_StallTimeout))
+	{
+		g_stallTimeout = atoi(Value);
+		return true;
+	}
+	if (!strcmp(Name, MenuEntry_KeepOnRestart))
+	{
+		g_keepOnRestart = (0 == strcmp(Value, "1"));
+		return true;
+	}
+	if (!strcmp(Name, MenuEntry_PauseForRecordings))
+	{
+		g_pauseForRecordings = (0 == strcmp(Value, "1"));
+		return true;
+	}
 	return false;
 }
 
@@ -372,16 +1250,52 @@ cMenuSetupLR::cMenuSetupLR()
 {
 	newEnablePlugin = g_enablePlugin;
 	newMaxLength = g_maxLength;
+	newMinFreeSpace = g_minFreeSpace;
+	newDeleteRate = g_deleteRate;
+	newSkipNetworkDisk = g_skipNetworkDisk;
+	newInactivityTimeout = g_inactivityTimeout;
+	newPrefetchSeconds = g_prefetchSeconds;
+	newAnalyzeStream = g_analyzeStream;
+	newStallTimeout = g_stallTimeout;
+	newKeepOnRestart = g_keepOnRestart;
+	newPauseForRecordings = g_pauseForRecordings;
 	Add(new cMenuEditBoolItem(tr("Enable plugin"), &newEnablePlugin));
 	Add(new cMenuEditIntItem(tr("Maximum recording length (hours)"), &newMaxLength, 1, 23));
+	Add(new cMenuEditIntItem(tr("Minimum free disk space (GB)"), &newMinFreeSpace, 0, 1000));
+	Add(new cMenuEditBoolItem(tr("Pause during other recordings"), &newPauseForRecordings));
+	Add(new cMenuEditIntItem(tr("Delete rate (MB/s)"), &newDeleteRate, 0, 1000, tr("unlimited")));
+	Add(new cMenuEditBoolItem(tr("Skip network video directory"), &newSkipNetworkDisk));
+	Add(new cMenuEditIntItem(tr("Stop after inactivity (min)"), &newInactivityTimeout, 0, 1440, tr("like VDR")));
+	Add(new cMenuEditIntItem(tr("Read ahead when rewinding (s)"), &newPrefetchSeconds, 0, 600, tr("off")));
+	Add(new cMenuEditBoolItem(tr("Log stream errors"), &newAnalyzeStream));
+	Add(new cMenuEditIntItem(tr("Warn when disk stalls (s)"), &newStallTimeout, 0, 600, tr("off")));
+	Add(new cMenuEditBoolItem(tr("Keep recording on restart"), &newKeepOnRestart));
 }
 
 void cMenuSetupLR::Store(void)
 {
 	g_enablePlugin = newEnablePlugin;
 	g_maxLength = newMaxLength;
+	g_minFreeSpace = newMinFreeSpace;
+	g_deleteRate = newDeleteRate;
+	g_skipNetworkDisk = newSkipNetworkDisk;
+	g_inactivityTimeout = newInactivityTimeout;
+	g_prefetchSeconds = newPrefetchSeconds;
+	g_analyzeStream = newAnalyzeStream;
+	g_stallTimeout = newStallTimeout;
+	g_keepOnRestart = newKeepOnRestart;
+	g_pauseForRecordings = newPauseForRecordings;
 	SetupStore(MenuEntry_EnablePlugin, newEnablePlugin);
 	SetupStore(MenuEntry_MaxLength, newMaxLength);
+	SetupStore(MenuEntry_MinFreeSpace, newMinFreeSpace);
+	SetupStore(MenuEntry_DeleteRate, newDeleteRate);
+	SetupStore(MenuEntry_SkipNetworkDisk, newSkipNetworkDisk);
+	SetupStore(MenuEntry_InactivityTimeout, newInactivityTimeout);
+	SetupStore(MenuEntry_PrefetchSeconds, newPrefetchSeconds);
+	SetupStore(MenuEntry_AnalyzeStream, newAnalyzeStream);
+	SetupStore(MenuEntry_StallTimeout, newStallTimeout);
+	SetupStore(MenuEntry_KeepOnRestart, newKeepOnRestart);
+	SetupStore(MenuEntry_PauseForRecordings, newPauseForRecordings);
 }
 
 
@@ -400,4 +1314,9 @@ void LRStatusMonitor::Recording(const cDevice *Device, const char *Name, const c
 	m_plugin->Recording(Device, Name, FileName, On);
 }
 
+void LRStatusMonitor::Replaying(const cControl *Control, const char *Name, const char *FileName, bool On)
+{
+	m_plugin->Replaying(Control, Name, FileName, On);
+}
+
 VDRPLUGINCREATOR(cPluginPermashift); // Don't touch this!
@@ -0,0 +1,162 @@
+/*
+ * prefetcher.c: Readahead for rewinding in a timeshift recording
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include "prefetcher.h"
+
+#include <fcntl.h>
+#include <vdr/recording.h>
+
+cPermashiftPrefetcher::cPermashiftPrefetcher(void) :
+	cThread("permashift prefetcher"),
+	m_framesPerSecond(DEFAULTFRAMESPERSECOND), m_seconds(0),
+	m_position(-1), m_pending(-1), m_hintedFrom(-1), m_hintedTo(-1),
+	m_index(NULL), m_fd(-1), m_fileNumber(0)
+{
+}
+
+cPermashiftPrefetcher::~cPermashiftPrefetcher()
+{
+	Stop();
+}
+
+void cPermashiftPrefetcher::Start(const char* fileName, double framesPerSecond, int seconds)
+{
+	Stop();
+	m_fileName = fileName;
+	m_framesPerSecond = framesPerSecond;
+	m_seconds = seconds;
+	m_position = -1;
+	m_pending = -1;
+	m_hintedFrom = -1;
+	m_hintedTo = -1;
+	cThread::Start();
+}
+
+void cPermashiftPrefetcher::Stop(void)
+{
+	if (Running())
+	{
+		Cancel(-1);
+		m_wait.Signal();
+		Cancel(3);
+	}
+	m_fileName = NULL;
+}
+
+void cPermashiftPrefetcher::SetPosition(int position, bool forward)
+{
+	// Going forward is handled well by the kernel's readahead.
+	bool backward = !forward || (m_position >= 0 && position < m_position);
+	m_position = position;
+	if (backward)
+	{
+		m_mutex.Lock();
+		m_pending = position;
+		m_mutex.Unlock();
+		m_wait.Signal();
+	}
+}
+
+bool cPermashiftPrefetcher::Advise(int fileNumber, off_t offset, off_t length)
+{
+	if (fileNumber != m_fileNumber || m_fd < 0)
+	{
+		if (m_fd >= 0)
+		{
+			close(m_fd);
+		}
+		m_fileNumber = fileNumber;
+		m_fd = open(cString::sprintf("%s/%05d.ts", *m_fileName, fileNumber), O_RDONLY);
+		if (m_fd < 0)
+		{
+			return false;
+		}
+	}
+	// starts the reads and returns without waiting for them
+	return posix_fadvise(m_fd, offset, length, POSIX_FADV_WILLNEED) == 0;
+}
+
+void cPermashiftPrefetcher::AdviseFrames(int from, int to)
+{
+	uint16_t firstNumber, lastNumber;
+	off_t firstOffset, lastOffset;
+	if (!m_index->Get(from, &firstNumber, &firstOffset) || !m_index->Get(to, &lastNumber, &lastOffset))
+	{
+		return;
+	}
+
+	// the region may span several files, the nearest ones go first
+	for (int number = lastNumber; number >= firstNumber; number--)
+	{
+		off_t offset = number == firstNumber ? firstOffset : 0;
+		if (number == lastNumber)
+		{
+			if (lastOffset > offset)
+			{
+				Advise(number, offset, lastOffset - offset);
+			}
+		}
+		else
+		{
+			// up to the end of the file
+			Advise(number, offset, 0);
+		}
+	}
+}
+
+void cPermashiftPrefetcher::Prefetch(int position)
+{
+	int first = max(0, position - int(m_seconds * m_framesPerSecond));
+
+	// While rewinding, the window only moves a bit each time,
+	// so only the part that wasn't hinted before is new.
+	if (m_hintedFrom >= 0 && position >= m_hintedFrom && position <= m_hintedTo)
+	{
+		if (first < m_hintedFrom)
+		{
+			AdviseFrames(first, m_hintedFrom);
+			m_hintedFrom = first;
+		}
+	}
+	else
+	{
+		AdviseFrames(first, position);
+		m_hintedFrom = first;
+		m_hintedTo = position;
+	}
+}
+
+void cPermashiftPrefetcher::Action(void)
+{
+	SetPriority(19);
+
+	m_index = new cIndexFile(m_fileName, false);
+	while (Running())
+	{
+		m_mutex.Lock();
+		int position = m_pending;
+		m_pending = -1;
+		m_mutex.Unlock();
+
+		if (position >= 0)
+		{
+			Prefetch(position);
+		}
+		else
+		{
+			m_wait.Wait(1000);
+		}
+	}
+
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+	delete m_index;
+	m_index = NULL;
+}
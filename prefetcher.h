@@ -0,0 +1,60 @@
+/*
+ * prefetcher.h: Readahead for rewinding in a timeshift recording
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __PERMASHIFT_PREFETCHER_H
+#define __PERMASHIFT_PREFETCHER_H
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+class cIndexFile;
+
+// The kernel only reads ahead when a file is read forward. When the user
+// rewinds or skips back in our recording, we tell it which part of the
+// recording will be needed next, so replay doesn't wait for the disk.
+
+class cPermashiftPrefetcher : public cThread
+{
+private:
+	cMutex m_mutex;
+	cCondWait m_wait;
+	cString m_fileName;
+	double m_framesPerSecond;
+	// seconds to read ahead of the replay position
+	int m_seconds;
+	// last position reported by replay
+	int m_position;
+	// position still to be handled by the thread, -1 = none
+	int m_pending;
+	// frames hinted last time, -1 = none
+	int m_hintedFrom;
+	int m_hintedTo;
+
+	cIndexFile* m_index;
+	int m_fd;
+	int m_fileNumber;
+
+	bool Advise(int fileNumber, off_t offset, off_t length);
+	void AdviseFrames(int from, int to);
+	void Prefetch(int position);
+
+protected:
+	virtual void Action(void);
+
+public:
+	cPermashiftPrefetcher(void);
+	virtual ~cPermashiftPrefetcher();
+
+	// start watching replay of the given recording
+	void Start(const char* fileName, double framesPerSecond, int seconds);
+	void Stop(void);
+
+	// report the current replay position, called from the main thread
+	void SetPosition(int position, bool forward);
+};
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * probes.h: Static tracing probes
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * With sys/sdt.h available (HAVE_SYS_SDT_H, see Makefile) these are USDT
+ * probes of provider "permashift", usable with perf, bpftrace or SystemTap,
+ * e.g. "bpftrace -l 'usdt:/path/to/libvdr-permashift.so:*'".
+ * They cost a nop each when nobody is tracing. Without sys/sdt.h they're
+ * compiled out.
+ */
+
+#ifndef __PERMASHIFT_PROBES_H
+#define __PERMASHIFT_PROBES_H
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define PERMASHIFT_PROBE1(name, a)          DTRACE_PROBE1(permashift, name, a)
+#define PERMASHIFT_PROBE2(name, a, b)       DTRACE_PROBE2(permashift, name, a, b)
+#else
+#define PERMASHIFT_PROBE1(name, a)
+#define PERMASHIFT_PROBE2(name, a, b)
+#endif
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * remover.c: Background removal of deleted timeshift recordings
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include "remover.h"
+#include "flightrecorder.h"
+#include "probes.h"
+#include "statistics.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <vdr/recording.h>
+#include <vdr/videodir.h>
+
+#define REMOVERSTEPSPERSECOND  10
+
+off_t DirectorySize(const char* directory)
+{
+	off_t size = 0;
+	cReadDir dir(directory);
+	if (dir.Ok())
+	{
+		struct dirent *e;
+		while ((e = dir.Next()) != NULL)
+		{
+			struct stat st;
+			if (stat(AddDirectory(directory, e->d_name), &st) == 0 && S_ISREG(st.st_mode))
+			{
+				size += st.st_size;
+			}
+		}
+	}
+	return size;
+}
+
+cPermashiftRemover::cPermashiftRemover(void) :
+	cThread("permashift remover"), m_rate(0), m_stopped(false)
+{
+}
+
+cPermashiftRemover::~cPermashiftRemover()
+{
+	Stop();
+}
+
+bool cPermashiftRemover::Remove(const char* fileName)
+{
+	m_mutex.Lock();
+	bool queued = !m_stopped && m_queue.Size() < REMOVERMAXQUEUE;
+	if (queued)
+	{
+		m_queue.Append(strdup(fileName));
+	}
+	m_mutex.Unlock();
+	if (!queued)
+	{
+		return false;
+	}
+
+	if (!Running())
+	{
+		Start();
+	}
+	m_wait.Signal();
+	return true;
+}
+
+void cPermashiftRemover::Stop(void)
+{
+	m_mutex.Lock();
+	m_stopped = true;
+	m_mutex.Unlock();
+
+	if (Running())
+	{
+		Cancel(-1);
+		m_wait.Signal();
+		Cancel(3);
+	}
+}
+
+bool cPermashiftRemover::IsDeleted(const char* fileName)
+{
+	cThreadLock DeletedRecordingsLock(&DeletedRecordings);
+	for (cRecording* r = DeletedRecordings.First(); r != NULL; r = DeletedRecordings.Next(r))
+	{
+		if (!strcmp(r->FileName(), fileName))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool cPermashiftRemover::Shrink(const char* fileName)
+{
+	struct stat st;
+	// stat() follows the symlinks used with several video directories
+	if (stat(fileName, &st) != 0)
+	{
+		return errno == ENOENT;
+	}
+	if (!S_ISREG(st.st_mode))
+	{
+		return true;
+	}
+
+	off_t step = (off_t)m_rate * MEGABYTE(1) / REMOVERSTEPSPERSECOND;
+	off_t size = st.st_size;
+	while (size > 0 && Running())
+	{
+		size = size > step ? size - step : 0;
+		PERMASHIFT_PROBE2(remove_step, fileName, size);
+		if (truncate(fileName, size) != 0)
+		{
+			// VDR removed it in the meantime
+			if (errno == ENOENT)
+			{
+				return true;
+			}
+			LOG_ERROR_STR(fileName);
+			return false;
+		}
+		if (size > 0)
+		{
+			cCondWait::SleepMs(1000 / REMOVERSTEPSPERSECOND);
+		}
+	}
+	return size == 0;
+}
+
+bool cPermashiftRemover::Truncate(const char* directory)
+{
+	if (m_rate <= 0)
+	{
+		return Running();
+	}
+
+	cReadDir dir(directory);
+	if (!dir.Ok())
+	{
+		// VDR may have removed it already
+		return errno == ENOENT;
+	}
+	struct dirent *e;
+	while ((e = dir.Next()) != NULL && Running())
+	{
+		if (strcmp(e->d_name, ".") && strcmp(e->d_name, ".."))
+		{
+			if (!Shrink(AddDirectory(directory, e->d_name)))
+			{
+				return false;
+			}
+		}
+	}
+	return Running();
+}
+
+cRecording* cPermashiftRemover::TakeDeleted(const char* fileName)
+{
+	cThreadLock DeletedRecordingsLock(&DeletedRecordings);
+	for (cRecording* r = DeletedRecordings.First(); r != NULL; r = DeletedRecordings.Next(r))
+	{
+		if (!strcmp(r->FileName(), fileName))
+		{
+			DeletedRecordings.Del(r, false);
+			return r;
+		}
+	}
+	return NULL;
+}
+
+void cPermashiftRemover::Action(void)
+{
+	SetPriority(19);
+	SetIOPriority(7);
+
+	// directories of instant recordings are left empty, VDR cleans them up
+	// after removing recordings, so we do the same
+	bool cleanUp = false;
+	time_t lastCleanUp = 0;
+
+	while (Running())
+	{
+		char* fileName = NULL;
+		m_mutex.Lock();
+		if (m_queue.Size() > 0)
+		{
+			fileName = m_queue[0];
+			m_queue.Remove(0);
+		}
+		m_mutex.Unlock();
+
+		if (fileName == NULL)
+		{
+			// the whole video directory is walked, so not after each recording
+			if (cleanUp && time(NULL) - lastCleanUp >= REMOVERCLEANUPDELTA)
+			{
+				cLockFile LockFile(VideoDirectory);
+				if (LockFile.Lock())
+				{
+					const char* IgnoreFiles[] = { ".sort", NULL };
+					RemoveEmptyVideoDirectories(IgnoreFiles);
+					cleanUp = false;
+					lastCleanUp = time(NULL);
+				}
+			}
+			m_wait.Wait(1000);
+			continue;
+		}
+
+		uint64_t removeTime = cPermashiftStatistics::Now();
+		PERMASHIFT_PROBE1(remove_begin, fileName);
+		bool deleted = IsDeleted(fileName);
+		if (deleted)
+		{
+			// what the recorder has written, counted here to keep the disk
+			// out of the channel switch
+			g_statistics.Count(ctBytesRecorded, DirectorySize(fileName));
+		}
+		if (deleted && Truncate(fileName) && Running())
+		{
+			// only one instance of VDR removes recordings at a time
+			cLockFile LockFile(VideoDirectory);
+			if (!LockFile.Lock())
+			{
+				dsyslog("Permashift: Video directory is locked, leaving %s to VDR", fileName);
+			}
+			else
+			{
+				// Only now take the recording from VDR's list, so housekeeping
+				// doesn't remove it at the same time. If VDR was quicker, it's gone.
+				cRecording* recording = TakeDeleted(fileName);
+				if (recording)
+				{
+					bool removed = recording->Remove();
+					delete recording;
+					cleanUp |= removed;
+					uint64_t duration = g_statistics.AddTime(stRemove, removeTime);
+					g_flightRecorder.Add(feRemove, 0, NULL, removed, duration);
+				}
+			}
+		}
+		PERMASHIFT_PROBE1(remove_end, fileName);
+		free(fileName);
+	}
+}
@@ -0,0 +1,64 @@
+/*
+ * remover.h: Background removal of deleted timeshift recordings
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __PERMASHIFT_REMOVER_H
+#define __PERMASHIFT_REMOVER_H
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+// Removes our deleted recordings right away with the lowest CPU and I/O
+// priority, instead of leaving them to VDR's housekeeping in the main thread.
+// Files are shrunk step by step before they are unlinked, so a large
+// timeshift buffer doesn't stall the disk for running recordings or replay.
+// The recording stays in DeletedRecordings until its files are gone, so VDR
+// may still remove it at once when it runs out of disk space. Like VDR, we
+// remove under the video directory's lock file and clean up the directories
+// left empty.
+
+#define REMOVERMAXQUEUE        10 // more are left to VDR
+#define REMOVERCLEANUPDELTA    60 // seconds between walks through the video directory
+
+class cRecording;
+
+// size of all files in a recording directory
+off_t DirectorySize(const char* directory);
+
+class cPermashiftRemover : public cThread
+{
+private:
+	cMutex m_mutex;
+	cCondWait m_wait;
+	cStringList m_queue;
+	// MB per second, 0 = no limit
+	int m_rate;
+	// no new work after Stop()
+	bool m_stopped;
+
+	bool IsDeleted(const char* fileName);
+	bool Shrink(const char* fileName);
+	bool Truncate(const char* directory);
+	// take the recording from DeletedRecordings, NULL if it's gone
+	cRecording* TakeDeleted(const char* fileName);
+
+protected:
+	virtual void Action(void);
+
+public:
+	cPermashiftRemover(void);
+	virtual ~cPermashiftRemover();
+
+	void SetRate(int rate) { m_rate = rate; };
+
+	// queue a recording directory renamed by cRecording::Delete(),
+	// returns false if it's left to VDR
+	bool Remove(const char* fileName);
+
+	void Stop(void);
+};
+
+#endif
@@ -0,0 +1,33 @@
+/*
+ * services.h: Service interface of the permashift plugin
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Other plugins may include this file and call
+ *
+ *   Permashift_BufferInfo_v1_0 info;
+ *   cPlugin *p = cPluginManager::CallFirstService(PERMASHIFT_BUFFERINFO_V1_0, &info);
+ *
+ * Calls don't block and are cheap enough to be made for every OSD update.
+ */
+
+#ifndef __PERMASHIFT_SERVICES_H
+#define __PERMASHIFT_SERVICES_H
+
+#include <time.h>
+
+#define PERMASHIFT_BUFFERINFO_V1_0  "Permashift-BufferInfo-v1.0"
+
+struct Permashift_BufferInfo_v1_0
+{
+	// false if there is no timeshift recording, the other fields are unset then
+	bool active;
+	int channelNumber;
+	// rewinding is possible from startTime up to endTime (which is now)
+	time_t startTime;
+	time_t endTime;
+	// directory of the recording, as in cRecording::FileName()
+	char fileName[1024];
+};
+
+#endif
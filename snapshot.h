@@ -0,0 +1,54 @@
+/*
+ * snapshot.h: State of the timeshift recording for other threads
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __PERMASHIFT_SNAPSHOT_H
+#define __PERMASHIFT_SNAPSHOT_H
+
+#include <vdr/tools.h>
+
+#include "services.h"
+
+// State of our recording for other plugins. Written by the main thread only,
+// readers retry while an update is in progress (sequence lock), so nobody
+// ever waits for a lock.
+
+class cBufferSnapshot
+{
+private:
+	volatile unsigned int m_sequence;
+	Permashift_BufferInfo_v1_0 m_info;
+
+public:
+	cBufferSnapshot(void) : m_sequence(0) { memset(&m_info, 0, sizeof(m_info)); };
+
+	void Set(bool active, int channelNumber, time_t startTime, const char* fileName)
+	{
+		m_sequence++;
+		__sync_synchronize();
+		m_info.active = active;
+		m_info.channelNumber = channelNumber;
+		m_info.startTime = startTime;
+		strn0cpy(m_info.fileName, fileName ? fileName : "", sizeof(m_info.fileName));
+		__sync_synchronize();
+		m_sequence++;
+	};
+
+	void Get(Permashift_BufferInfo_v1_0* info)
+	{
+		unsigned int sequence;
+		do
+		{
+			sequence = m_sequence;
+			__sync_synchronize();
+			memcpy(info, &m_info, sizeof(*info));
+			__sync_synchronize();
+		} while ((sequence & 1) || sequence != m_sequence);
+		info->endTime = info->active ? time(NULL) : 0;
+	};
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * statistics.c: Latency histograms and counters
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include "statistics.h"
+
+#include <stdio.h>
+#include <time.h>
+
+cPermashiftStatistics g_statistics;
+
+static const char* StageNames[stCount] =
+{
+	"zap", "start", "validate", "process", "delete", "remove"
+};
+
+static const char* CounterNames[ctCount] =
+{
+	"zaps", "starts", "start_failures", "stops", "deletes", "delete_failures", "recorded_bytes", "stalls"
+};
+
+static const char* GaugeNames[gaCount] =
+{
+	"timers", "recordings"
+};
+
+cPermashiftStatistics::cPermashiftStatistics(void)
+{
+	memset(m_histograms, 0, sizeof(m_histograms));
+	memset(m_counters, 0, sizeof(m_counters));
+	memset(m_gauges, 0, sizeof(m_gauges));
+}
+
+uint64_t cPermashiftStatistics::Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void cPermashiftStatistics::AddDuration(eStage stage, uint64_t us)
+{
+	int bucket = 0;
+	while (bucket < STATISTICSBUCKETS - 1 && us > (uint64_t(1) << bucket))
+	{
+		bucket++;
+	}
+	tHistogram &h = m_histograms[stage];
+	__sync_fetch_and_add(&h.buckets[bucket], 1);
+	__sync_fetch_and_add(&h.count, 1);
+	__sync_fetch_and_add(&h.sumUs, us);
+}
+
+void cPermashiftStatistics::Count(eCounter counter, uint64_t value)
+{
+	__sync_fetch_and_add(&m_counters[counter], value);
+}
+
+uint64_t cPermashiftStatistics::Percentile(eStage stage, double share) const
+{
+	const tHistogram &h = m_histograms[stage];
+	uint64_t wanted = uint64_t(h.count * share + 0.5);
+	uint64_t sum = 0;
+	for (int i = 0; i < STATISTICSBUCKETS - 1; i++)
+	{
+		sum += h.buckets[i];
+		if (sum >= wanted)
+		{
+			return uint64_t(1) << i;
+		}
+	}
+	return uint64_t(1) << (STATISTICSBUCKETS - 1);
+}
+
+void cPermashiftStatistics::WriteSummary(FILE* f) const
+{
+	for (int c = 0; c < ctCount; c++)
+	{
+		fprintf(f, "%s: %llu\n", CounterNames[c], (unsigned long long)m_counters[c]);
+	}
+	for (int g = 0; g < gaCount; g++)
+	{
+		fprintf(f, "%s: %d\n", GaugeNames[g], m_gauges[g]);
+	}
+	for (int s = 0; s < stCount; s++)
+	{
+		const tHistogram &h = m_histograms[s];
+		if (h.count > 0)
+		{
+			fprintf(f, "%s: %llu times, avg %.1f ms, p50 < %.1f ms, p99 < %.1f ms\n",
+				StageNames[s], (unsigned long long)h.count, double(h.sumUs) / h.count / 1000,
+				double(Percentile(eStage(s), 0.5)) / 1000, double(Percentile(eStage(s), 0.99)) / 1000);
+		}
+	}
+}
+
+void cPermashiftStatistics::WriteText(FILE* f) const
+{
+	for (int c = 0; c < ctCount; c++)
+	{
+		fprintf(f, "# TYPE permashift_%s_total counter\npermashift_%s_total %llu\n",
+			CounterNames[c], CounterNames[c], (unsigned long long)m_counters[c]);
+	}
+	// the start/stop path scans these lists, so their size matters
+	for (int g = 0; g < gaCount; g++)
+	{
+		fprintf(f, "# TYPE permashift_%s gauge\npermashift_%s %d\n",
+			GaugeNames[g], GaugeNames[g], m_gauges[g]);
+	}
+
+	fputs("# TYPE permashift_stage_duration_seconds histogram\n", f);
+	for (int s = 0; s < stCount; s++)
+	{
+		const tHistogram &h = m_histograms[s];
+		uint64_t sum = 0;
+		for (int i = 0; i < STATISTICSBUCKETS - 1; i++)
+		{
+			sum += h.buckets[i];
+			fprintf(f, "permashift_stage_duration_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n",
+				StageNames[s], double(uint64_t(1) << i) / 1000000, (unsigned long long)sum);
+		}
+		fprintf(f, "permashift_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n"
+			"permashift_stage_duration_seconds_sum{stage=\"%s\"} %.6f\n"
+			"permashift_stage_duration_seconds_count{stage=\"%s\"} %llu\n",
+			StageNames[s], (unsigned long long)h.count,
+			StageNames[s], double(h.sumUs) / 1000000,
+			StageNames[s], (unsigned long long)h.count);
+	}
+}
+
+// collects the output of one of the Write functions in a single growing buffer
+static cString ToString(const cPermashiftStatistics *statistics, void (cPermashiftStatistics::*write)(FILE*) const)
+{
+	char* buffer = NULL;
+	size_t size = 0;
+	FILE* f = open_memstream(&buffer, &size);
+	if (!f)
+	{
+		return "";
+	}
+	(statistics->*write)(f);
+	fclose(f);
+	return cString(buffer, true);
+}
+
+cString cPermashiftStatistics::Summary(void) const
+{
+	return ToString(this, &cPermashiftStatistics::WriteSummary);
+}
+
+cString cPermashiftStatistics::ToText(void) const
+{
+	return ToString(this, &cPermashiftStatistics::WriteText);
+}
+
+bool cPermashiftStatistics::Save(const char* fileName) const
+{
+	// written to a temporary file and renamed, so readers never see half a file
+	cSafeFile f(fileName);
+	if (!f.Open())
+	{
+		return false;
+	}
+	WriteText(f);
+	return f.Close();
+}
@@ -0,0 +1,94 @@
+/*
+ * statistics.h: Latency histograms and counters
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __PERMASHIFT_STATISTICS_H
+#define __PERMASHIFT_STATISTICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vdr/tools.h>
+
+// upper bounds of the buckets are 1, 2, 4, ... microseconds, the last is unlimited
+#define STATISTICSBUCKETS  28
+
+enum eStage
+{
+	stZap,          // ChannelSwitch away from a channel until the new recording runs
+	stStart,        // cRecordControls::Start
+	stValidate,     // looking up our timer in StopLiveRecording
+	stProcess,      // cRecordControls::Process stopping the recording
+	stDelete,       // cRecording::Delete and removing it from the list
+	stRemove,       // removing the files in the background
+	stCount
+};
+
+enum eCounter
+{
+	ctZaps,
+	ctStarts,
+	ctStartFailures,
+	ctStops,
+	ctDeletes,
+	ctDeleteFailures,
+	ctBytesRecorded,
+	ctStalls,
+	ctCount
+};
+
+enum eGauge
+{
+	gaTimers,
+	gaRecordings,
+	gaCount
+};
+
+// Updated with atomic additions only, so it may be used from any thread
+// without locking. A snapshot read while it's updated may be off by one
+// event, which doesn't matter for statistics.
+
+class cPermashiftStatistics
+{
+private:
+	struct tHistogram
+	{
+		uint64_t buckets[STATISTICSBUCKETS];
+		uint64_t count;
+		uint64_t sumUs;
+	};
+
+	tHistogram m_histograms[stCount];
+	uint64_t m_counters[ctCount];
+	int m_gauges[gaCount];
+
+public:
+	cPermashiftStatistics(void);
+
+	// monotonic time in microseconds
+	static uint64_t Now(void);
+
+	void AddDuration(eStage stage, uint64_t us);
+	// adds the time since startUs and returns it
+	uint64_t AddTime(eStage stage, uint64_t startUs) { uint64_t us = Now() - startUs; AddDuration(stage, us); return us; };
+	void Count(eCounter counter, uint64_t value = 1);
+	uint64_t Counter(eCounter counter) const { return m_counters[counter]; };
+	void Set(eGauge gauge, int value) { m_gauges[gauge] = value; };
+
+	// duration in microseconds below which the given share (0..1) of the events were
+	uint64_t Percentile(eStage stage, double share) const;
+
+	// short human readable overview
+	void WriteSummary(FILE* f) const;
+	cString Summary(void) const;
+	// all values in Prometheus text format
+	void WriteText(FILE* f) const;
+	cString ToText(void) const;
+	bool Save(const char* fileName) const;
+};
+
+extern cPermashiftStatistics g_statistics;
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * bench.c: Cost of a channel switch with a large number of timers and recordings
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <vdr/plugin.h>
+
+#include "../statistics.h"
+
+extern "C" void *VDRPluginCreator(void);
+
+#define BENCHZAPS 100
+
+static const int Sizes[] = { 100, 10000, 100000 };
+
+// Fills Timers and Recordings with entries that aren't ours: timers of
+// tomorrow, so none of them matches, and recordings of other channels.
+static void Populate(int size)
+{
+	for (int i = 0; i < size; i++)
+	{
+		cTimer* timer = new cTimer(false, false, Channels.GetByNumber(3));
+		timer->Skip();
+		Timers.Add(timer);
+		Recordings.Add(new cRecording(cString::sprintf("%s/Library/%06d.rec", VideoDirectory, i)));
+	}
+}
+
+// average microseconds per channel switch
+static uint64_t Zap(int size)
+{
+	Populate(size);
+	cPlugin* plugin = (cPlugin*)VDRPluginCreator();
+	plugin->SetName("permashift");
+	plugin->SetupParse("KeepOnRestart", "0");
+	plugin->Start();
+	cDevice::StubSwitchChannel(1);
+
+	uint64_t total = 0;
+	for (int i = 0; i < BENCHZAPS; i++)
+	{
+		uint64_t start = cPermashiftStatistics::Now();
+		cDevice::StubSwitchChannel(i % 2 ? 1 : 2);
+		total += cPermashiftStatistics::Now() - start;
+	}
+
+	plugin->Stop();
+	delete plugin;
+	cRecordControls::Shutdown();
+	Timers.Clear();
+	Recordings.Clear();
+	DeletedRecordings.Clear();
+	return total / BENCHZAPS;
+}
+
+int main(int argc, char *argv[])
+{
+	StubVerbose = argc > 1 && !strcmp(argv[1], "-v");
+
+	char directory[] = "/tmp/permashift-bench-XXXXXX";
+	if (!mkdtemp(directory))
+	{
+		perror(directory);
+		return 2;
+	}
+	cString videoDirectory = AddDirectory(directory, "video");
+	MakeDirs(videoDirectory, true);
+	VideoDirectory = videoDirectory;
+	cPlugin::SetConfigDirectory(AddDirectory(directory, "config"));
+	for (int i = 1; i <= 3; i++)
+	{
+		Channels.Add(new cChannel(i, cString::sprintf("Channel %d", i), 100 + i));
+	}
+
+	printf("%10s %10s\n", "entries", "zap us");
+	for (unsigned int i = 0; i < sizeof(Sizes) / sizeof(Sizes[0]); i++)
+	{
+		printf("%10d %10llu\n", Sizes[i], (unsigned long long)Zap(Sizes[i]));
+	}
+
+	RemoveFileOrDir(directory);
+	return 0;
+}
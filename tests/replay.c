@@ -0,0 +1,233 @@
+/*
+ * replay.c: Replays a trace of channel switches against the plugin
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <vdr/plugin.h>
+#include <algorithm>
+#include <sys/resource.h>
+
+#include "../flightrecorder.h"
+#include "../statistics.h"
+
+extern "C" void *VDRPluginCreator(void);
+
+#define REPLAYPACKETSPERSECOND 5 // of trace time, written by the stub recorder
+#define REPLAYMAXDWELL         (3 * 3600) // seconds, longer isn't recorded anyway
+#define REPLAYTOLERANCE        1.5 // latencies and memory may grow by this factor
+#define REPLAYSLACKUS          250 // latency changes below this are noise
+#define REPLAYSLACKKB          1024
+
+struct tZap
+{
+	double time;     // seconds since some start
+	int channel;
+};
+
+// A trace is either a flight recorder dump, of which the ends of the
+// channel switches are taken, or text with "seconds channel" per line.
+static bool ReadTrace(const char* fileName, std::vector<tZap> &zaps)
+{
+	FILE* f = fopen(fileName, "r");
+	if (!f)
+	{
+		perror(fileName);
+		return false;
+	}
+	tFlightHeader header;
+	if (fread(&header, sizeof(header), 1, f) == 1 && !memcmp(header.magic, FLIGHTRECORDERMAGIC, sizeof(header.magic)))
+	{
+		tFlightEvent event;
+		while (fread(&event, sizeof(event), 1, f) == 1)
+		{
+			if (event.type == feZapEnd && event.channel > 0)
+			{
+				tZap zap = { event.timeUs / 1000000.0, event.channel };
+				zaps.push_back(zap);
+			}
+		}
+	}
+	else
+	{
+		rewind(f);
+		cReadLine reader;
+		char* line;
+		while ((line = reader.Read(f)) != NULL)
+		{
+			tZap zap;
+			if (*line != '#' && sscanf(line, "%lf %d", &zap.time, &zap.channel) == 2 && zap.channel > 0)
+			{
+				zaps.push_back(zap);
+			}
+		}
+	}
+	fclose(f);
+	return !zaps.empty();
+}
+
+// what the live channel sends while the user stays on it
+static void Play(int packets)
+{
+	uchar p[TS_SIZE];
+	memset(p, 0xFF, TS_SIZE);
+	p[0] = TS_SYNC_BYTE;
+	p[1] = 0x01;
+	p[2] = 0x00;
+	for (int i = 0; i < packets; i++)
+	{
+		p[3] = 0x10 | (i & 0x0F);
+		cDevice::PrimaryDevice()->StubPlayTs(p, TS_SIZE);
+	}
+}
+
+struct tResult
+{
+	const char* name;
+	unsigned long long value;
+	unsigned long long slack;  // 0 = must stay the same
+};
+
+static uint64_t Percentile(std::vector<uint64_t> values, double share)
+{
+	std::sort(values.begin(), values.end());
+	size_t i = size_t(share * values.size());
+	return values[min(i, values.size() - 1)];
+}
+
+// Latencies and memory fail if they grew beyond the tolerance, counts if
+// they changed at all: the same trace has to cause the same work.
+static bool Compare(const char* fileName, const std::vector<tResult> &results)
+{
+	FILE* f = fopen(fileName, "r");
+	if (!f)
+	{
+		fprintf(stderr, "No baseline in %s, nothing to compare\n", fileName);
+		return true;
+	}
+	bool ok = true;
+	char name[64];
+	unsigned long long baseline;
+	while (fscanf(f, "%63s %llu", name, &baseline) == 2)
+	{
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const tResult &r = results[i];
+			if (strcmp(r.name, name))
+			{
+				continue;
+			}
+			bool regressed = r.slack ? r.value > baseline * REPLAYTOLERANCE + r.slack : r.value != baseline;
+			fprintf(stderr, "%-16s %12llu  baseline %12llu%s\n", r.name, r.value, baseline, regressed ? "  REGRESSION" : "");
+			ok &= !regressed;
+		}
+	}
+	fclose(f);
+	if (!ok)
+	{
+		fprintf(stderr, "Worse than %s; if that's intended, refresh it with 'make replay-baseline'\n", fileName);
+	}
+	return ok;
+}
+
+static bool NoDeletedRecordings(void)
+{
+	return DeletedRecordings.Count() == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s TRACE [BASELINE]\n", argv[0]);
+		return 2;
+	}
+	std::vector<tZap> zaps;
+	if (!ReadTrace(argv[1], zaps))
+	{
+		fprintf(stderr, "No channel switches in %s\n", argv[1]);
+		return 2;
+	}
+
+	char directory[] = "/tmp/permashift-replay-XXXXXX";
+	if (!mkdtemp(directory))
+	{
+		perror(directory);
+		return 2;
+	}
+	cString videoDirectory = AddDirectory(directory, "video");
+	MakeDirs(videoDirectory, true);
+	VideoDirectory = videoDirectory;
+	cPlugin::SetConfigDirectory(AddDirectory(directory, "config"));
+	int channels = 0;
+	for (size_t i = 0; i < zaps.size(); i++)
+	{
+		channels = max(channels, zaps[i].channel);
+	}
+	for (int i = 1; i <= channels; i++)
+	{
+		Channels.Add(new cChannel(i, cString::sprintf("Channel %d", i), 100 + i));
+	}
+
+	cPlugin* plugin = (cPlugin*)VDRPluginCreator();
+	plugin->SetName("permashift");
+	plugin->SetupParse("KeepOnRestart", "0");
+	plugin->Start();
+
+	// as fast as the plugin goes, the time between switches only decides
+	// how much is recorded
+	std::vector<uint64_t> latencies;
+	for (size_t i = 0; i < zaps.size(); i++)
+	{
+		if (i > 0)
+		{
+			double seconds = min(max(zaps[i].time - zaps[i - 1].time, 0.0), double(REPLAYMAXDWELL));
+			Play(int(seconds * REPLAYPACKETSPERSECOND));
+		}
+		uint64_t start = cPermashiftStatistics::Now();
+		cDevice::StubSwitchChannel(zaps[i].channel);
+		latencies.push_back(cPermashiftStatistics::Now() - start);
+		// the remover's work belongs to this switch, not to the next one
+		for (int n = 0; n < 500 && !NoDeletedRecordings(); n++)
+		{
+			cCondWait::SleepMs(10);
+		}
+	}
+
+	plugin->Stop();
+	delete plugin;
+	cRecordControls::Shutdown();
+	// what's left is VDR's
+	while (DeletedRecordings.First())
+	{
+		cRecording* recording = DeletedRecordings.First();
+		recording->Remove();
+		DeletedRecordings.Del(recording);
+	}
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	std::vector<tResult> results;
+	tResult r[] =
+	{
+		{ "zaps", latencies.size(), 0 },
+		{ "p50_us", Percentile(latencies, 0.5), REPLAYSLACKUS },
+		{ "p99_us", Percentile(latencies, 0.99), REPLAYSLACKUS },
+		{ "starts", g_statistics.Counter(ctStarts), 0 },
+		{ "deletes", g_statistics.Counter(ctDeletes), 0 },
+		{ "bytes_written", StubBytesWritten, 0 },
+		{ "files_created", (unsigned long long)StubFilesCreated, 0 },
+		{ "files_deleted", (unsigned long long)StubFilesRemoved, 0 },
+		{ "peak_rss_kb", (unsigned long long)usage.ru_maxrss, REPLAYSLACKKB },
+	};
+	for (size_t i = 0; i < sizeof(r) / sizeof(r[0]); i++)
+	{
+		results.push_back(r[i]);
+		printf("%s %llu\n", r[i].name, r[i].value);
+	}
+
+	RemoveFileOrDir(directory);
+	return argc < 3 || Compare(argv[2], results) ? 0 : 1;
+}
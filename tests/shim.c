@@ -0,0 +1,126 @@
+/*
+ * shim.c: Faults and delays of file system calls, for the tests
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include "shim.h"
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+extern "C"
+{
+int __real_stat(const char *path, struct stat *buf);
+int __real_truncate(const char *path, off_t length);
+int __real_unlink(const char *path);
+FILE *__real_fopen(const char *path, const char *mode);
+int __real_fsync(int fd);
+int __real_rename(const char *oldpath, const char *newpath);
+}
+
+struct tShimFault
+{
+	char* path;
+	int error;
+	int delayMs;
+	int hits;
+};
+
+static cMutex g_shimMutex;
+static tShimFault g_shimFaults[scCount];
+
+void ShimFault(eShimCall call, const char* path, int error, int delayMs)
+{
+	cMutexLock lock(&g_shimMutex);
+	tShimFault &fault = g_shimFaults[call];
+	free(fault.path);
+	fault.path = strdup(path ? path : "");
+	fault.error = error;
+	fault.delayMs = delayMs;
+	fault.hits = 0;
+}
+
+void ShimClear(void)
+{
+	cMutexLock lock(&g_shimMutex);
+	for (int i = 0; i < scCount; i++)
+	{
+		free(g_shimFaults[i].path);
+		g_shimFaults[i].path = NULL;
+		g_shimFaults[i].hits = 0;
+	}
+}
+
+int ShimHits(eShimCall call)
+{
+	cMutexLock lock(&g_shimMutex);
+	return g_shimFaults[call].hits;
+}
+
+// true if the call is to fail with errno set, after any delay
+static bool Fault(eShimCall call, const char* path)
+{
+	int error = 0;
+	int delayMs = 0;
+	{
+		cMutexLock lock(&g_shimMutex);
+		tShimFault &fault = g_shimFaults[call];
+		if (!fault.path || !path || !strstr(path, fault.path))
+		{
+			return false;
+		}
+		fault.hits++;
+		error = fault.error;
+		delayMs = fault.delayMs;
+	}
+	// a hanging call must not hold up the other threads' calls
+	if (delayMs > 0)
+	{
+		cCondWait::SleepMs(delayMs);
+	}
+	errno = error;
+	return error != 0;
+}
+
+extern "C"
+{
+
+int __wrap_stat(const char *path, struct stat *buf)
+{
+	return Fault(scStat, path) ? -1 : __real_stat(path, buf);
+}
+
+int __wrap_truncate(const char *path, off_t length)
+{
+	return Fault(scTruncate, path) ? -1 : __real_truncate(path, length);
+}
+
+int __wrap_unlink(const char *path)
+{
+	return Fault(scUnlink, path) ? -1 : __real_unlink(path);
+}
+
+FILE *__wrap_fopen(const char *path, const char *mode)
+{
+	return Fault(scFopen, path) ? NULL : __real_fopen(path, mode);
+}
+
+// the path of the descriptor is what the fault is set for
+int __wrap_fsync(int fd)
+{
+	char path[PATH_MAX];
+	ssize_t n = readlink(cString::sprintf("/proc/self/fd/%d", fd), path, sizeof(path) - 1);
+	path[n > 0 ? n : 0] = 0;
+	return Fault(scFsync, path) ? -1 : __real_fsync(fd);
+}
+
+int __wrap_rename(const char *oldpath, const char *newpath)
+{
+	return Fault(scRename, newpath) ? -1 : __real_rename(oldpath, newpath);
+}
+
+}
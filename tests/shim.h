@@ -0,0 +1,32 @@
+/*
+ * shim.h: Faults and delays of file system calls, for the tests
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * The test program is linked with --wrap for the calls below, so the
+ * plugin's and the stub's calls go through shim.c first. A fault applies
+ * to the paths containing the given text and makes the call wait before
+ * it fails with the given errno, or with 0 before it's done as usual.
+ */
+
+#ifndef __PERMASHIFT_SHIM_H
+#define __PERMASHIFT_SHIM_H
+
+enum eShimCall
+{
+	scStat,
+	scTruncate,
+	scUnlink,
+	scFopen,
+	scFsync,
+	scRename,
+	scCount
+};
+
+void ShimFault(eShimCall call, const char* path, int error, int delayMs = 0);
+// back to the plain calls
+void ShimClear(void);
+// how often a fault has been applied since the last ShimClear()
+int ShimHits(eShimCall call);
+
+#endif
@@ -0,0 +1,1187 @@
+/*
+ * stub.c: Stand-in for the parts of VDR the plugin uses
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <vdr/stub.h>
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/time.h>
+
+// tools
+
+bool StubVerbose = false;
+
+void StubLog(const char *fmt, ...)
+{
+	if (StubVerbose)
+	{
+		va_list ap;
+		va_start(ap, fmt);
+		vfprintf(stderr, fmt, ap);
+		va_end(ap);
+		fputc('\n', stderr);
+	}
+}
+
+char *strn0cpy(char *dest, const char *src, size_t n)
+{
+	char *s = dest;
+	for (; --n && (*dest = *src) != 0; dest++, src++)
+		;
+	*dest = 0;
+	return s;
+}
+
+bool MakeDirs(const char *FileName, bool IsDirectory)
+{
+	char *s = strdup(FileName);
+	char *p = s;
+	if (*p == '/')
+	{
+		p++;
+	}
+	bool result = true;
+	while ((p = strchr(p, '/')) != NULL || IsDirectory)
+	{
+		if (p)
+		{
+			*p = 0;
+		}
+		if (mkdir(s, 0755) != 0 && errno != EEXIST)
+		{
+			LOG_ERROR_STR(s);
+			result = false;
+			break;
+		}
+		if (!p)
+		{
+			break;
+		}
+		*p++ = '/';
+	}
+	free(s);
+	return result;
+}
+
+int StubFilesCreated = 0;
+int StubFilesRemoved = 0;
+uint64_t StubBytesWritten = 0;
+
+bool RemoveFileOrDir(const char *FileName)
+{
+	struct stat st;
+	if (lstat(FileName, &st) != 0)
+	{
+		return errno == ENOENT;
+	}
+	if (S_ISDIR(st.st_mode))
+	{
+		cReadDir d(FileName);
+		struct dirent *e;
+		while ((e = d.Next()) != NULL)
+		{
+			if (!RemoveFileOrDir(AddDirectory(FileName, e->d_name)))
+			{
+				return false;
+			}
+		}
+		return rmdir(FileName) == 0;
+	}
+	if (unlink(FileName) != 0)
+	{
+		return false;
+	}
+	StubFilesRemoved++;
+	return true;
+}
+
+bool RemoveEmptyDirectories(const char *DirName, bool RemoveThis, const char *IgnoreFiles[])
+{
+	cReadDir d(DirName);
+	if (!d.Ok())
+	{
+		return false;
+	}
+	bool empty = true;
+	cStringList ignored;
+	struct dirent *e;
+	while ((e = d.Next()) != NULL)
+	{
+		cString buffer = AddDirectory(DirName, e->d_name);
+		struct stat st;
+		if (stat(buffer, &st) == 0 && S_ISDIR(st.st_mode))
+		{
+			if (!RemoveEmptyDirectories(buffer, true, IgnoreFiles))
+			{
+				empty = false;
+			}
+			continue;
+		}
+		bool ignore = false;
+		for (const char **i = IgnoreFiles; RemoveThis && i && *i; i++)
+		{
+			ignore |= !strcmp(*i, e->d_name);
+		}
+		if (ignore)
+		{
+			ignored.Append(strdup(buffer));
+		}
+		else
+		{
+			empty = false;
+		}
+	}
+	if (RemoveThis && empty)
+	{
+		for (int i = 0; i < ignored.Size(); i++)
+		{
+			unlink(ignored[i]);
+		}
+		return rmdir(DirName) == 0;
+	}
+	return empty;
+}
+
+cString::cString(const char *S, bool TakePointer)
+{
+	s = TakePointer ? (char *)S : S ? strdup(S) : NULL;
+}
+
+cString::cString(const cString &String)
+{
+	s = String.s ? strdup(String.s) : NULL;
+}
+
+cString::~cString()
+{
+	free(s);
+}
+
+cString &cString::operator=(const cString &String)
+{
+	if (this != &String)
+	{
+		free(s);
+		s = String.s ? strdup(String.s) : NULL;
+	}
+	return *this;
+}
+
+cString &cString::operator=(const char *String)
+{
+	if (s != String)
+	{
+		free(s);
+		s = String ? strdup(String) : NULL;
+	}
+	return *this;
+}
+
+cString cString::sprintf(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	char *buffer;
+	if (vasprintf(&buffer, fmt, ap) < 0)
+	{
+		buffer = strdup("???");
+	}
+	va_end(ap);
+	return cString(buffer, true);
+}
+
+cString AddDirectory(const char *DirName, const char *FileName)
+{
+	return cString::sprintf("%s/%s", DirName && *DirName ? DirName : ".", FileName);
+}
+
+void cStringList::Clear(void)
+{
+	for (size_t i = 0; i < m_strings.size(); i++)
+	{
+		free(m_strings[i]);
+	}
+	m_strings.clear();
+}
+
+char *cReadLine::Read(FILE *f)
+{
+	ssize_t n = getline(&buffer, &size, f);
+	if (n <= 0)
+	{
+		return NULL;
+	}
+	if (buffer[n - 1] == '\n')
+	{
+		buffer[n - 1] = 0;
+	}
+	return buffer;
+}
+
+cReadDir::cReadDir(const char *Directory)
+{
+	directory = opendir(Directory);
+}
+
+cReadDir::~cReadDir()
+{
+	if (directory)
+	{
+		closedir(directory);
+	}
+}
+
+struct dirent *cReadDir::Next(void)
+{
+	struct dirent *e;
+	while (directory && (e = readdir(directory)) != NULL)
+	{
+		if (strcmp(e->d_name, ".") && strcmp(e->d_name, ".."))
+		{
+			return e;
+		}
+	}
+	return NULL;
+}
+
+cSafeFile::cSafeFile(const char *FileName)
+{
+	f = NULL;
+	fileName = strdup(FileName);
+	if (asprintf(&tempName, "%s.$$$", FileName) < 0)
+	{
+		tempName = NULL;
+	}
+}
+
+cSafeFile::~cSafeFile()
+{
+	if (f)
+	{
+		fclose(f);
+	}
+	// like VDR, also after a failed Close()
+	if (tempName)
+	{
+		unlink(tempName);
+	}
+	free(fileName);
+	free(tempName);
+}
+
+bool cSafeFile::Open(void)
+{
+	if (!f && tempName)
+	{
+		f = fopen(tempName, "w");
+		if (!f)
+		{
+			LOG_ERROR_STR(tempName);
+		}
+	}
+	return f != NULL;
+}
+
+bool cSafeFile::Close(void)
+{
+	bool result = true;
+	if (f)
+	{
+		if (fflush(f) != 0 || fsync(fileno(f)) < 0)
+		{
+			result = false;
+		}
+		if (fclose(f) < 0)
+		{
+			result = false;
+		}
+		f = NULL;
+		if (result && rename(tempName, fileName) < 0)
+		{
+			result = false;
+		}
+	}
+	else
+	{
+		result = false;
+	}
+	return result;
+}
+
+cLockFile::cLockFile(const char *Directory)
+{
+	fileName = strdup(AddDirectory(Directory, ".lock-vdr"));
+	f = -1;
+}
+
+cLockFile::~cLockFile()
+{
+	Unlock();
+	free(fileName);
+}
+
+bool cLockFile::Lock(int WaitSeconds)
+{
+	if (f < 0)
+	{
+		f = open(fileName, O_WRONLY | O_CREAT | O_EXCL, 0644);
+	}
+	return f >= 0;
+}
+
+void cLockFile::Unlock(void)
+{
+	if (f >= 0)
+	{
+		close(f);
+		unlink(fileName);
+		f = -1;
+	}
+}
+
+void cListBase::Add(cListObject *Object, cListObject *After)
+{
+	if (After && After != lastObject)
+	{
+		After->next->prev = Object;
+		Object->next = After->next;
+		After->next = Object;
+		Object->prev = After;
+	}
+	else
+	{
+		Object->prev = lastObject;
+		Object->next = NULL;
+		if (lastObject)
+		{
+			lastObject->next = Object;
+		}
+		else
+		{
+			objects = Object;
+		}
+		lastObject = Object;
+	}
+	count++;
+}
+
+void cListBase::Del(cListObject *Object, bool DeleteObject)
+{
+	if (Object == objects)
+	{
+		objects = Object->next;
+	}
+	if (Object == lastObject)
+	{
+		lastObject = Object->prev;
+	}
+	if (Object->prev)
+	{
+		Object->prev->next = Object->next;
+	}
+	if (Object->next)
+	{
+		Object->next->prev = Object->prev;
+	}
+	Object->prev = Object->next = NULL;
+	if (DeleteObject)
+	{
+		delete Object;
+	}
+	count--;
+}
+
+void cListBase::Clear(void)
+{
+	while (objects)
+	{
+		cListObject *object = objects->next;
+		delete objects;
+		objects = object;
+	}
+	objects = lastObject = NULL;
+	count = 0;
+}
+
+// thread
+
+cMutex::cMutex(void)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+cMutex::~cMutex()
+{
+	pthread_mutex_destroy(&mutex);
+}
+
+void cMutex::Lock(void)
+{
+	pthread_mutex_lock(&mutex);
+}
+
+void cMutex::Unlock(void)
+{
+	pthread_mutex_unlock(&mutex);
+}
+
+cMutexLock::cMutexLock(cMutex *Mutex)
+{
+	mutex = Mutex;
+	if (mutex)
+	{
+		mutex->Lock();
+	}
+}
+
+cMutexLock::~cMutexLock()
+{
+	if (mutex)
+	{
+		mutex->Unlock();
+	}
+}
+
+cCondWait::cCondWait(void)
+{
+	signaled = false;
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&cond, NULL);
+}
+
+cCondWait::~cCondWait()
+{
+	pthread_cond_destroy(&cond);
+	pthread_mutex_destroy(&mutex);
+}
+
+void cCondWait::SleepMs(int TimeoutMs)
+{
+	usleep(max(TimeoutMs, 3) * 1000);
+}
+
+bool cCondWait::Wait(int TimeoutMs)
+{
+	pthread_mutex_lock(&mutex);
+	if (!signaled)
+	{
+		if (TimeoutMs)
+		{
+			struct timeval now;
+			gettimeofday(&now, NULL);
+			struct timespec abstime;
+			uint64_t us = uint64_t(now.tv_usec) + uint64_t(TimeoutMs) * 1000;
+			abstime.tv_sec = now.tv_sec + us / 1000000;
+			abstime.tv_nsec = (us % 1000000) * 1000;
+			while (!signaled)
+			{
+				if (pthread_cond_timedwait(&cond, &mutex, &abstime) == ETIMEDOUT)
+				{
+					break;
+				}
+			}
+		}
+		else
+		{
+			while (!signaled)
+			{
+				pthread_cond_wait(&cond, &mutex);
+			}
+		}
+	}
+	bool r = signaled;
+	signaled = false;
+	pthread_mutex_unlock(&mutex);
+	return r;
+}
+
+void cCondWait::Signal(void)
+{
+	pthread_mutex_lock(&mutex);
+	signaled = true;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&mutex);
+}
+
+cCondVar::cCondVar(void)
+{
+	pthread_cond_init(&cond, NULL);
+}
+
+cCondVar::~cCondVar()
+{
+	pthread_cond_destroy(&cond);
+}
+
+void cCondVar::Wait(cMutex &Mutex)
+{
+	pthread_cond_wait(&cond, &Mutex.mutex);
+}
+
+bool cCondVar::TimedWait(cMutex &Mutex, int TimeoutMs)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	struct timespec abstime;
+	uint64_t us = uint64_t(now.tv_usec) + uint64_t(TimeoutMs) * 1000;
+	abstime.tv_sec = now.tv_sec + us / 1000000;
+	abstime.tv_nsec = (us % 1000000) * 1000;
+	return pthread_cond_timedwait(&cond, &Mutex.mutex, &abstime) != ETIMEDOUT;
+}
+
+void cCondVar::Broadcast(void)
+{
+	pthread_cond_broadcast(&cond);
+}
+
+cThread::cThread(const char *Description, bool LowPriority)
+{
+	active = running = false;
+	childTid = 0;
+}
+
+cThread::~cThread()
+{
+	Cancel(); // just in case the derived class didn't call it
+}
+
+void *cThread::StartThread(cThread *Thread)
+{
+	Thread->Action();
+	Thread->running = false;
+	Thread->active = false;
+	return NULL;
+}
+
+bool cThread::Start(void)
+{
+	if (!running)
+	{
+		// wait until the previous incarnation of this thread has ended
+		for (int i = 0; active && i < 300; i++)
+		{
+			cCondWait::SleepMs(10);
+		}
+		if (!active)
+		{
+			active = running = true;
+			if (pthread_create(&childTid, NULL, (void *(*) (void *))&StartThread, (void *)this) == 0)
+			{
+				pthread_detach(childTid);
+			}
+			else
+			{
+				active = running = false;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void cThread::Cancel(int WaitSeconds)
+{
+	running = false;
+	if (active && WaitSeconds > -1)
+	{
+		if (WaitSeconds > 0)
+		{
+			for (time_t t0 = time(NULL) + WaitSeconds; time(NULL) < t0; )
+			{
+				if (!Active())
+				{
+					return;
+				}
+				cCondWait::SleepMs(10);
+			}
+			esyslog("ERROR: thread won't end (waited %d seconds) - canceling it...", WaitSeconds);
+		}
+		pthread_cancel(childTid);
+		childTid = 0;
+		active = false;
+	}
+}
+
+cThreadLock::cThreadLock(cThread *Thread)
+{
+	thread = Thread;
+	if (thread)
+	{
+		thread->Lock();
+	}
+}
+
+cThreadLock::~cThreadLock()
+{
+	if (thread)
+	{
+		thread->Unlock();
+	}
+}
+
+// config
+
+cSetup Setup;
+
+cSetup::cSetup(void)
+{
+	InstantRecordTime = 180;
+	DefaultPriority = 50;
+	DefaultLifetime = 99;
+	PausePriority = 10;
+	PauseLifetime = 1;
+}
+
+// channels
+
+cChannels Channels;
+
+tChannelID tChannelID::FromString(const char *s)
+{
+	tChannelID id;
+	if (sscanf(s, "T-1-1-%d", &id.sid) != 1)
+	{
+		id.sid = 0;
+	}
+	return id;
+}
+
+cString tChannelID::ToString(void) const
+{
+	return cString::sprintf("T-1-1-%d", sid);
+}
+
+tChannelID cChannel::GetChannelID(void) const
+{
+	tChannelID id;
+	id.sid = sid;
+	return id;
+}
+
+cChannel *cChannels::GetByNumber(int Number, int SkipGap)
+{
+	for (cChannel *channel = First(); channel; channel = Next(channel))
+	{
+		if (channel->Number() == Number)
+		{
+			return channel;
+		}
+	}
+	return NULL;
+}
+
+// timers
+
+cTimers Timers;
+
+cTimer::cTimer(bool Instant, bool Pause, cChannel *Channel)
+{
+	time_t t = time(NULL);
+	struct tm tm_r;
+	localtime_r(&t, &tm_r);
+	start = tm_r.tm_hour * 100 + tm_r.tm_min;
+	stop = tm_r.tm_hour * 60 + tm_r.tm_min + Setup.InstantRecordTime;
+	stop = (stop / 60) * 100 + (stop % 60);
+	if (stop >= 2400)
+	{
+		stop -= 2400;
+	}
+	tm_r.tm_hour = tm_r.tm_min = tm_r.tm_sec = 0;
+	tm_r.tm_isdst = -1;
+	day = mktime(&tm_r);
+	priority = Pause ? Setup.PausePriority : Setup.DefaultPriority;
+	lifetime = Pause ? Setup.PauseLifetime : Setup.DefaultLifetime;
+	recording = false;
+	channel = Channel ? Channel : Channels.GetByNumber(cDevice::CurrentChannel());
+}
+
+time_t cTimer::StartTime(void) const
+{
+	return day + (start / 100) * 3600 + (start % 100) * 60;
+}
+
+time_t cTimer::StopTime(void) const
+{
+	time_t t = day + (stop / 100) * 3600 + (stop % 100) * 60;
+	return stop <= start ? t + 24 * 3600 : t;
+}
+
+void cTimers::Add(cTimer *Timer, cTimer *After)
+{
+	cListBase::Add(Timer, After);
+	cStatus::MsgTimerChange(Timer, tcAdd);
+}
+
+void cTimers::Del(cTimer *Timer, bool DeleteObject)
+{
+	cStatus::MsgTimerChange(Timer, tcDel);
+	cListBase::Del(Timer, DeleteObject);
+}
+
+// recordings
+
+cRecordings Recordings;
+cRecordings DeletedRecordings;
+
+cRecording::cRecording(const char *FileName)
+{
+	fileName = strdup(FileName);
+}
+
+cRecording::~cRecording()
+{
+	free(fileName);
+}
+
+bool cRecording::Delete(void)
+{
+	bool result = true;
+	char *NewName = strdup(FileName());
+	char *ext = strrchr(NewName, '.');
+	if (ext && strcmp(ext, ".rec") == 0)
+	{
+		strcpy(ext, ".del");
+		if (access(NewName, F_OK) == 0)
+		{
+			RemoveFileOrDir(NewName);
+		}
+		if (access(FileName(), F_OK) == 0)
+		{
+			result = rename(FileName(), NewName) == 0;
+		}
+	}
+	free(NewName);
+	return result;
+}
+
+bool cRecording::Remove(void)
+{
+	// VDR's final safety check
+	const char *ext = strrchr(FileName(), '.');
+	if (!ext || strcmp(ext, ".del"))
+	{
+		esyslog("attempt to remove recording %s", FileName());
+		return false;
+	}
+	return RemoveFileOrDir(FileName());
+}
+
+cRecording *cRecordings::GetByName(const char *FileName)
+{
+	if (FileName)
+	{
+		cThreadLock RecordingsLock(this);
+		for (cRecording *recording = First(); recording; recording = Next(recording))
+		{
+			if (strcmp(recording->FileName(), FileName) == 0)
+			{
+				return recording;
+			}
+		}
+	}
+	return NULL;
+}
+
+void cRecordings::AddByName(const char *FileName)
+{
+	cThreadLock RecordingsLock(this);
+	if (!GetByName(FileName))
+	{
+		Add(new cRecording(FileName));
+	}
+}
+
+void cRecordings::DelByName(const char *FileName)
+{
+	cThreadLock RecordingsLock(this);
+	cRecording *recording = GetByName(FileName);
+	if (recording)
+	{
+		cThreadLock DeletedRecordingsLock(&DeletedRecordings);
+		Del(recording, false);
+		char *ext = strrchr(recording->fileName, '.');
+		if (ext)
+		{
+			strcpy(ext, ".del");
+			if (access(recording->FileName(), F_OK) == 0)
+			{
+				DeletedRecordings.Add(recording);
+				recording = NULL;
+			}
+		}
+		delete recording;
+	}
+}
+
+cIndexFile::cIndexFile(const char *FileName, bool Record, bool IsPesRecording, bool PauseLive)
+{
+	FILE *f = fopen(AddDirectory(FileName, "index"), "r");
+	if (f)
+	{
+		tIndexTs entry;
+		while (fread(&entry, sizeof(entry), 1, f) == 1)
+		{
+			index.push_back(entry);
+		}
+		fclose(f);
+	}
+}
+
+bool cIndexFile::Get(int Index, uint16_t *FileNumber, off_t *FileOffset, bool *Independent, int *Length)
+{
+	if (Index < 0 || Index >= int(index.size()))
+	{
+		return false;
+	}
+	*FileNumber = index[Index].number;
+	*FileOffset = index[Index].offset;
+	if (Independent)
+	{
+		*Independent = index[Index].independent;
+	}
+	if (Length)
+	{
+		bool next = Index + 1 < int(index.size()) && index[Index + 1].number == index[Index].number;
+		*Length = next ? int(index[Index + 1].offset - index[Index].offset) : -1;
+	}
+	return true;
+}
+
+// devices
+
+int cDevice::currentChannel = 0;
+
+cDevice *cDevice::PrimaryDevice(void)
+{
+	static cDevice device;
+	return &device;
+}
+
+bool cDevice::AttachReceiver(cReceiver *Receiver)
+{
+	if (Receiver->device == this)
+	{
+		return true;
+	}
+	receivers.push_back(Receiver);
+	Receiver->device = this;
+	Receiver->Activate(true);
+	return true;
+}
+
+void cDevice::Detach(cReceiver *Receiver)
+{
+	for (size_t i = 0; i < receivers.size(); i++)
+	{
+		if (receivers[i] == Receiver)
+		{
+			receivers.erase(receivers.begin() + i);
+			Receiver->device = NULL;
+			Receiver->Activate(false);
+			return;
+		}
+	}
+}
+
+void cDevice::StubPlayTs(uchar *Data, int Length)
+{
+	std::vector<cReceiver *> r = receivers;
+	for (size_t i = 0; i < r.size(); i++)
+	{
+		r[i]->Receive(Data, Length);
+	}
+}
+
+void cDevice::StubSwitchChannel(int Number)
+{
+	cStatus::MsgChannelSwitch(PrimaryDevice(), 0, true);
+	currentChannel = Number;
+	cStatus::MsgChannelSwitch(PrimaryDevice(), Number, true);
+}
+
+cReceiver::~cReceiver()
+{
+	if (device)
+	{
+		esyslog("ERROR: cReceiver has not been detached yet! This is a design fault and VDR will segfault now!");
+		abort();
+	}
+}
+
+void cReceiver::Detach(void)
+{
+	if (device)
+	{
+		device->Detach(this);
+	}
+}
+
+// records
+
+// Writes what it receives like VDR's cRecorder: the data to the next free
+// %05d.ts file, and an index entry for each call of Receive(), which stands
+// for a frame.
+
+class cStubRecorder : public cReceiver
+{
+private:
+	FILE *m_ts;
+	FILE *m_index;
+	uint16_t m_number;
+	off_t m_offset;
+
+protected:
+	virtual void Receive(uchar *Data, int Length);
+
+public:
+	cStubRecorder(const char *FileName);
+	virtual ~cStubRecorder();
+};
+
+cStubRecorder::cStubRecorder(const char *FileName)
+{
+	m_number = 1;
+	while (access(cString::sprintf("%s/%05d.ts", FileName, m_number), F_OK) == 0)
+	{
+		m_number++;
+	}
+	cString index = AddDirectory(FileName, "index");
+	StubFilesCreated += access(index, F_OK) == 0 ? 1 : 2;
+	m_ts = fopen(cString::sprintf("%s/%05d.ts", FileName, m_number), "w");
+	m_index = fopen(index, "a");
+	m_offset = 0;
+}
+
+cStubRecorder::~cStubRecorder()
+{
+	Detach();
+	if (m_ts)
+	{
+		fclose(m_ts);
+	}
+	if (m_index)
+	{
+		fclose(m_index);
+	}
+}
+
+void cStubRecorder::Receive(uchar *Data, int Length)
+{
+	if (!m_ts || !m_index)
+	{
+		return;
+	}
+	tIndexTs entry;
+	memset(&entry, 0, sizeof(entry));
+	entry.offset = m_offset;
+	entry.independent = 1;
+	entry.number = m_number;
+	StubBytesWritten += fwrite(&entry, 1, sizeof(entry), m_index);
+	fflush(m_index);
+	size_t written = fwrite(Data, 1, Length, m_ts);
+	StubBytesWritten += written;
+	m_offset += written;
+	fflush(m_ts);
+}
+
+cRecordControl::cRecordControl(cDevice *Device, cTimer *Timer, bool Pause)
+{
+	device = Device;
+	timer = Timer;
+	if (!timer)
+	{
+		timer = new cTimer(true, Pause);
+		Timers.Add(timer);
+		Timers.SetModified();
+	}
+	timer->SetRecording(true);
+
+	// the same timer always records to the same directory, as in VDR
+	time_t start = timer->StartTime();
+	struct tm tm_r;
+	localtime_r(&start, &tm_r);
+	cString name = cString::sprintf("@%s", timer->Channel()->Name());
+	fileName = strdup(cString::sprintf("%s/%s/%4d-%02d-%02d.%02d.%02d.%d-%d.rec", VideoDirectory, *name,
+		tm_r.tm_year + 1900, tm_r.tm_mon + 1, tm_r.tm_mday, tm_r.tm_hour, tm_r.tm_min,
+		timer->Channel()->Number(), 0));
+	recorder = NULL;
+	if (MakeDirs(fileName, true))
+	{
+		recorder = new cStubRecorder(fileName);
+		device->AttachReceiver(recorder);
+		cStatus::MsgRecording(device, name, fileName, true);
+		Recordings.AddByName(fileName);
+	}
+}
+
+cRecordControl::~cRecordControl()
+{
+	if (timer)
+	{
+		DELETENULL(recorder);
+		timer->SetRecording(false);
+		timer = NULL;
+		cStatus::MsgRecording(device, NULL, fileName, false);
+	}
+	free(fileName);
+}
+
+bool cRecordControl::Process(time_t t)
+{
+	return recorder && recorder->IsAttached() && timer && timer->Matches(t);
+}
+
+std::vector<cRecordControl *> cRecordControls::recordControls;
+
+bool cRecordControls::Start(cTimer *Timer, bool Pause)
+{
+	cChannel *channel = Timer ? Timer->Channel() : Channels.GetByNumber(cDevice::CurrentChannel());
+	if (!channel)
+	{
+		return false;
+	}
+	if (Timer && !Timer->Matches(time(NULL)))
+	{
+		return false;
+	}
+	cRecordControl *control = new cRecordControl(cDevice::PrimaryDevice(), Timer, Pause);
+	recordControls.push_back(control);
+	return control->Process(time(NULL));
+}
+
+cRecordControl *cRecordControls::GetRecordControl(const cTimer *Timer)
+{
+	for (size_t i = 0; i < recordControls.size(); i++)
+	{
+		if (recordControls[i]->Timer() == Timer)
+		{
+			return recordControls[i];
+		}
+	}
+	return NULL;
+}
+
+void cRecordControls::Process(time_t t)
+{
+	for (size_t i = 0; i < recordControls.size(); )
+	{
+		if (!recordControls[i]->Process(t))
+		{
+			delete recordControls[i];
+			recordControls.erase(recordControls.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+void cRecordControls::Shutdown(void)
+{
+	for (size_t i = 0; i < recordControls.size(); i++)
+	{
+		delete recordControls[i];
+	}
+	recordControls.clear();
+}
+
+// status
+
+cList<cStatus> cStatus::statusMonitors;
+
+cStatus::cStatus(void)
+{
+	statusMonitors.Add(this);
+}
+
+cStatus::~cStatus()
+{
+	statusMonitors.Del(this, false);
+}
+
+void cStatus::MsgChannelSwitch(const cDevice *Device, int ChannelNumber, bool LiveView)
+{
+	for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
+	{
+		sm->ChannelSwitch(Device, ChannelNumber, LiveView);
+	}
+}
+
+void cStatus::MsgTimerChange(const cTimer *Timer, eTimerChange Change)
+{
+	for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
+	{
+		sm->TimerChange(Timer, Change);
+	}
+}
+
+void cStatus::MsgRecording(const cDevice *Device, const char *Name, const char *FileName, bool On)
+{
+	for (cStatus *sm = statusMonitors.First(); sm; sm = statusMonitors.Next(sm))
+	{
+		sm->Recording(Device, Name, FileName, On);
+	}
+}
+
+cShutdownHandler ShutdownHandler;
+
+int StubConfirmations = 0;
+static cInterface StubInterface;
+cInterface *Interface = &StubInterface;
+
+// video directory
+
+const char *VideoDirectory = "/video";
+
+void RemoveEmptyVideoDirectories(const char *IgnoreFiles[])
+{
+	RemoveEmptyDirectories(VideoDirectory, false, IgnoreFiles);
+}
+
+int VideoDiskSpace(int *FreeMB, int *UsedMB)
+{
+	struct statvfs st;
+	if (statvfs(VideoDirectory, &st) != 0)
+	{
+		return 0;
+	}
+	long long total = (long long)st.f_blocks * st.f_frsize / MEGABYTE(1);
+	long long free = (long long)st.f_bavail * st.f_frsize / MEGABYTE(1);
+	if (FreeMB)
+	{
+		*FreeMB = int(free);
+	}
+	if (UsedMB)
+	{
+		*UsedMB = int(total - free);
+	}
+	return total ? int((total - free) * 100 / total) : 0;
+}
+
+// plugins
+
+char *cPlugin::configDirectory = NULL;
+
+void cPlugin::SetConfigDirectory(const char *Dir)
+{
+	free(configDirectory);
+	configDirectory = strdup(Dir);
+}
+
+const char *cPlugin::ConfigDirectory(const char *PluginName)
+{
+	static cString buffer;
+	buffer = cString::sprintf("%s/plugins%s%s", configDirectory, PluginName ? "/" : "", PluginName ? PluginName : "");
+	return MakeDirs(buffer, true) ? *buffer : NULL;
+}
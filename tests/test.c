@@ -0,0 +1,767 @@
+/*
+ * test.c: Behaviour checks of the permashift plugin against the stub VDR
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <vdr/plugin.h>
+#include <sched.h>
+#include <sys/stat.h>
+
+#include "../analyzer.h"
+#include "../flightrecorder.h"
+#include "../remover.h"
+#include "../services.h"
+#include "../snapshot.h"
+#include "../statistics.h"
+#include "../watchdog.h"
+#include "shim.h"
+
+extern "C" void *VDRPluginCreator(void);
+
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(condition) Check(condition, #condition, __FILE__, __LINE__)
+
+static void Check(bool ok, const char* text, const char* file, int line)
+{
+	checks++;
+	if (!ok)
+	{
+		failures++;
+		fprintf(stderr, "%s:%d: check failed: %s\n", file, line, text);
+	}
+}
+
+static cString g_testDirectory;
+
+static off_t FileSize(const char* fileName)
+{
+	struct stat st;
+	return stat(fileName, &st) == 0 ? st.st_size : -1;
+}
+
+static bool Exists(const char* fileName)
+{
+	return access(fileName, F_OK) == 0;
+}
+
+static int CountFiles(const char* directory)
+{
+	int files = 0;
+	cReadDir dir(directory);
+	while (dir.Next())
+	{
+		files++;
+	}
+	return files;
+}
+
+// waits up to five seconds for a background thread
+static bool WaitFor(bool (*condition)(void))
+{
+	for (int i = 0; i < 500; i++)
+	{
+		if (condition())
+		{
+			return true;
+		}
+		cCondWait::SleepMs(10);
+	}
+	return false;
+}
+
+// a TS packet, 'payload' 0 = adaptation field only
+static void MakePacket(uchar* p, int pid, int cc, bool payload = true, bool discontinuity = false, bool scrambled = false, bool tei = false)
+{
+	memset(p, 0xFF, TS_SIZE);
+	p[0] = TS_SYNC_BYTE;
+	p[1] = (tei ? 0x80 : 0) | ((pid >> 8) & 0x1F);
+	p[2] = pid & 0xFF;
+	bool adaptation = discontinuity || !payload;
+	p[3] = (scrambled ? 0x80 : 0) | (adaptation ? 0x20 : 0) | (payload ? 0x10 : 0) | (cc & 0x0F);
+	if (adaptation)
+	{
+		p[4] = payload ? 1 : TS_SIZE - 5;
+		p[5] = discontinuity ? 0x80 : 0;
+	}
+}
+
+static void Play(int pid, int cc, bool payload = true, bool discontinuity = false, bool scrambled = false, bool tei = false)
+{
+	uchar p[TS_SIZE];
+	MakePacket(p, pid, cc, payload, discontinuity, scrambled, tei);
+	cDevice::PrimaryDevice()->StubPlayTs(p, TS_SIZE);
+}
+
+// statistics
+
+static void TestHistogram(void)
+{
+	cPermashiftStatistics statistics;
+	CHECK(statistics.Percentile(stZap, 0.5) == 1);
+
+	statistics.AddDuration(stZap, 1);      // up to 1 us
+	statistics.AddDuration(stZap, 3);      // up to 4 us
+	statistics.AddDuration(stZap, 1000);   // up to 1024 us
+	statistics.AddDuration(stZap, uint64_t(1) << 40);  // beyond the last bound
+	CHECK(statistics.Percentile(stZap, 0.25) == 1);
+	CHECK(statistics.Percentile(stZap, 0.5) == 4);
+	CHECK(statistics.Percentile(stZap, 0.75) == 1024);
+	CHECK(statistics.Percentile(stZap, 1.0) == uint64_t(1) << (STATISTICSBUCKETS - 1));
+	CHECK(statistics.Percentile(stStart, 0.99) == 1);
+
+	statistics.Count(ctZaps);
+	statistics.Count(ctBytesRecorded, 1000);
+	statistics.Set(gaRecordings, 7);
+
+	// buckets are cumulative, the last one counts everything
+	cString text = statistics.ToText();
+	CHECK(strstr(text, "permashift_zaps_total 1\n") != NULL);
+	CHECK(strstr(text, "permashift_recorded_bytes_total 1000\n") != NULL);
+	CHECK(strstr(text, "permashift_recordings 7\n") != NULL);
+	CHECK(strstr(text, "permashift_stage_duration_seconds_bucket{stage=\"zap\",le=\"1e-06\"} 1\n") != NULL);
+	CHECK(strstr(text, "permashift_stage_duration_seconds_bucket{stage=\"zap\",le=\"2e-06\"} 1\n") != NULL);
+	CHECK(strstr(text, "permashift_stage_duration_seconds_bucket{stage=\"zap\",le=\"4e-06\"} 2\n") != NULL);
+	CHECK(strstr(text, "permashift_stage_duration_seconds_bucket{stage=\"zap\",le=\"+Inf\"} 4\n") != NULL);
+	CHECK(strstr(text, "permashift_stage_duration_seconds_count{stage=\"zap\"} 4\n") != NULL);
+	CHECK(strstr(text, "permashift_stage_duration_seconds_count{stage=\"start\"} 0\n") != NULL);
+
+	cString summary = statistics.Summary();
+	CHECK(strstr(summary, "zaps: 1\n") != NULL);
+	CHECK(strstr(summary, "zap: 4 times") != NULL);
+	CHECK(strstr(summary, "start:") == NULL);
+
+	cString fileName = AddDirectory(g_testDirectory, "metrics.prom");
+	CHECK(statistics.Save(fileName));
+	CHECK(FileSize(fileName) == off_t(strlen(text)));
+}
+
+// snapshot
+
+class cSnapshotWriter : public cThread
+{
+private:
+	cBufferSnapshot* m_snapshot;
+
+protected:
+	virtual void Action(void)
+	{
+		char a[1000], b[1000];
+		memset(a, 'a', sizeof(a) - 1);
+		a[sizeof(a) - 1] = 0;
+		memset(b, 'b', sizeof(b) - 1);
+		b[sizeof(b) - 1] = 0;
+		while (Running())
+		{
+			// give readers a chance to run on a single processor, too
+			m_snapshot->Set(true, 1, 100, a);
+			sched_yield();
+			m_snapshot->Set(false, 2, 200, b);
+			sched_yield();
+		}
+	}
+
+public:
+	cSnapshotWriter(cBufferSnapshot* snapshot) : m_snapshot(snapshot) {}
+	void Stop(void) { Cancel(3); }
+};
+
+static void TestSnapshot(void)
+{
+	cBufferSnapshot snapshot;
+	Permashift_BufferInfo_v1_0 info;
+	snapshot.Get(&info);
+	CHECK(!info.active && info.endTime == 0 && info.fileName[0] == 0);
+
+	snapshot.Set(true, 5, 1000, "/video/x.rec");
+	snapshot.Get(&info);
+	CHECK(info.active && info.channelNumber == 5 && info.startTime == 1000);
+	CHECK(!strcmp(info.fileName, "/video/x.rec"));
+	CHECK(info.endTime >= time(NULL) - 1);
+
+	// a reader never sees a mix of two updates
+	cSnapshotWriter writer(&snapshot);
+	writer.Start();
+	do
+	{
+		snapshot.Get(&info);
+	} while (info.channelNumber == 5);
+	int torn = 0;
+	for (int i = 0; i < 100000; i++)
+	{
+		snapshot.Get(&info);
+		char c = info.channelNumber == 1 ? 'a' : 'b';
+		if (info.active != (info.channelNumber == 1) || info.startTime != info.channelNumber * 100 ||
+			strlen(info.fileName) != 999 || info.fileName[0] != c || info.fileName[998] != c)
+		{
+			torn++;
+		}
+	}
+	writer.Stop();
+	CHECK(torn == 0);
+}
+
+// analyzer
+
+static void TestContinuity(void)
+{
+	cChannel channel(1, "Test", 101);
+	cPermashiftAnalyzer* analyzer = new cPermashiftAnalyzer(&channel);
+	CHECK(cDevice::PrimaryDevice()->AttachReceiver(analyzer));
+	unsigned int packets, ccErrors, teiErrors, scrambled;
+
+	// in order, a single repetition is allowed
+	Play(0x100, 14);
+	Play(0x100, 15);
+	Play(0x100, 0);
+	Play(0x100, 0);
+	Play(0x100, 1);
+	analyzer->Totals(packets, ccErrors, teiErrors, scrambled);
+	CHECK(packets == 5 && ccErrors == 0);
+
+	// a second repetition is an error
+	Play(0x100, 1);
+	Play(0x100, 1);
+	analyzer->Totals(packets, ccErrors, teiErrors, scrambled);
+	CHECK(ccErrors == 1);
+
+	// a gap is an error
+	Play(0x100, 5);
+	analyzer->Totals(packets, ccErrors, teiErrors, scrambled);
+	CHECK(ccErrors == 2);
+
+	// without payload the counter stays
+	Play(0x100, 9, false);
+	Play(0x100, 6);
+	analyzer->Totals(packets, ccErrors, teiErrors, scrambled);
+	CHECK(ccErrors == 2);
+
+	// a signalled discontinuity starts anew
+	Play(0x100, 12, true, true);
+	Play(0x100, 13);
+	analyzer->Totals(packets, ccErrors, teiErrors, scrambled);
+	CHECK(ccErrors == 2);
+
+	// each PID has its own counter
+	Play(0x200, 3);
+	Play(0x200, 4, true, false, true);
+	Play(0x200, 5, true, false, false, true);
+	Play(0x100, 14);
+	analyzer->Totals(packets, ccErrors, teiErrors, scrambled);
+	CHECK(packets == 16 && ccErrors == 2 && scrambled == 1 && teiErrors == 1);
+
+	// the destructor detaches
+	delete analyzer;
+	Play(0x100, 0);
+}
+
+// flight recorder
+
+static void TestFlightRecorder(void)
+{
+	cString directory = AddDirectory(g_testDirectory, "flightrecorder");
+	MakeDirs(directory, true);
+	cPermashiftFlightRecorder recorder;
+	recorder.SetDirectory(directory);
+	for (int i = 0; i < FLIGHTRECORDEREVENTS + 10; i++)
+	{
+		recorder.Add(feZapStart, i);
+	}
+
+	// one file, replaced by each dump
+	cString first = recorder.Dump();
+	cString second = recorder.Dump();
+	CHECK(*first && *second && !strcmp(first, second));
+	CHECK(!strcmp(first, AddDirectory(directory, FLIGHTRECORDERFILE)));
+	CHECK(FileSize(first) == off_t(sizeof(tFlightHeader) + FLIGHTRECORDEREVENTS * sizeof(tFlightEvent)));
+
+	FILE* f = fopen(first, "r");
+	tFlightHeader header;
+	tFlightEvent event;
+	CHECK(f && fread(&header, sizeof(header), 1, f) == 1 && fread(&event, sizeof(event), 1, f) == 1);
+	if (f)
+	{
+		fclose(f);
+	}
+	CHECK(!memcmp(header.magic, FLIGHTRECORDERMAGIC, sizeof(header.magic)));
+	CHECK(header.count == FLIGHTRECORDEREVENTS && header.eventSize == sizeof(tFlightEvent));
+	// the oldest events have been overwritten
+	CHECK(event.channel == 10 && event.type == feZapStart);
+
+	// errors go to their own file, at most once a minute
+	recorder.DumpOnError();
+	cString error = AddDirectory(directory, FLIGHTRECORDERERRFILE);
+	CHECK(Exists(error));
+	unlink(error);
+	recorder.DumpOnError();
+	CHECK(!Exists(error));
+	CHECK(CountFiles(directory) == 1);
+
+	// a failed dump leaves the previous one intact and nothing behind
+	recorder.Add(feZapStart, FLIGHTRECORDEREVENTS + 10);
+	eShimCall calls[] = { scFopen, scFsync, scRename };
+	for (unsigned int i = 0; i < sizeof(calls) / sizeof(calls[0]); i++)
+	{
+		ShimFault(calls[i], directory, ENOSPC);
+		CHECK(!*recorder.Dump());
+		CHECK(ShimHits(calls[i]) == 1);
+		ShimClear();
+	}
+	f = fopen(first, "r");
+	CHECK(f && fread(&header, sizeof(header), 1, f) == 1 && fread(&event, sizeof(event), 1, f) == 1);
+	if (f)
+	{
+		fclose(f);
+	}
+	CHECK(event.channel == 10);
+	CHECK(CountFiles(directory) == 1);
+}
+
+// watchdog
+
+static void TestWatchdog(void)
+{
+	cString directory = AddDirectory(g_testDirectory, "watchdog.rec");
+	MakeDirs(directory, true);
+	cString index = AddDirectory(directory, "index");
+	time_t start = time(NULL);
+	cPermashiftWatchdog* watchdog = cPermashiftWatchdog::Start(directory);
+	CHECK(watchdog != NULL);
+	if (watchdog == NULL)
+	{
+		return;
+	}
+	CHECK(watchdog->LastGrowth() >= start);
+
+	// a growing index is seen within about a second
+	cCondWait::SleepMs(1100);
+	fclose(fopen(index, "w"));
+	CHECK(truncate(index, 8) == 0);
+	time_t written = time(NULL);
+	bool seen = false;
+	for (int i = 0; i < 30 && !seen; i++)
+	{
+		cCondWait::SleepMs(100);
+		seen = watchdog->LastGrowth() >= written;
+	}
+	CHECK(seen);
+
+	// doesn't wait for the thread
+	uint64_t stopTime = cPermashiftStatistics::Now();
+	watchdog->Stop();
+	CHECK(cPermashiftStatistics::Now() - stopTime < 100000);
+
+	// an index that can't be read doesn't grow
+	ShimFault(scStat, directory, EIO);
+	watchdog = cPermashiftWatchdog::Start(directory);
+	CHECK(watchdog != NULL);
+	if (watchdog == NULL)
+	{
+		return;
+	}
+	time_t growth = watchdog->LastGrowth();
+	CHECK(truncate(index, 16) == 0);
+	cCondWait::SleepMs(1100);
+	CHECK(watchdog->LastGrowth() == growth && ShimHits(scStat) >= 2);
+	watchdog->Stop();
+
+	// nor does a stat() hanging on a network disk hold up Stop(), or the
+	// watchdog of the next recording
+	ShimFault(scStat, directory, 0, 1000);
+	watchdog = cPermashiftWatchdog::Start(directory);
+	CHECK(watchdog != NULL);
+	if (watchdog == NULL)
+	{
+		return;
+	}
+	cCondWait::SleepMs(100);
+	CHECK(ShimHits(scStat) == 1);
+	stopTime = cPermashiftStatistics::Now();
+	watchdog->Stop();
+	CHECK(cPermashiftStatistics::Now() - stopTime < 100000);
+	ShimClear();
+	watchdog = cPermashiftWatchdog::Start(directory);
+	CHECK(watchdog != NULL);
+	cCondWait::SleepMs(100);
+	if (watchdog)
+	{
+		watchdog->Stop();
+	}
+	// the hanging one deletes itself once stat() returns
+	cCondWait::SleepMs(1000);
+}
+
+// remover
+
+static cString MakeDeletedRecording(const char* name, int files, int megabytes)
+{
+	cString fileName = cString::sprintf("%s/%s.rec", VideoDirectory, name);
+	MakeDirs(fileName, true);
+	for (int i = 1; i <= files; i++)
+	{
+		cString ts = cString::sprintf("%s/%05d.ts", *fileName, i);
+		if (truncate(ts, 0) != 0)
+		{
+			fclose(fopen(ts, "w"));
+		}
+		CHECK(truncate(ts, MEGABYTE(megabytes)) == 0);
+	}
+	Recordings.AddByName(fileName);
+	CHECK(Recordings.GetByName(fileName)->Delete());
+	Recordings.DelByName(fileName);
+	return cString::sprintf("%s/%s.del", VideoDirectory, name);
+}
+
+static bool NoDeletedRecordings(void)
+{
+	return DeletedRecordings.Count() == 0;
+}
+
+static bool OneDeletedRecording(void)
+{
+	return DeletedRecordings.Count() == 1;
+}
+
+static bool RemoverDirectoryGone(void)
+{
+	return !Exists(cString::sprintf("%s/remover", VideoDirectory));
+}
+
+static void TestRemover(void)
+{
+	cPermashiftRemover remover;
+
+	// removed step by step, the entry stays in VDR's list until the files are gone
+	uint64_t bytes = g_statistics.Counter(ctBytesRecorded);
+	cString deleted = MakeDeletedRecording("remover/slow", 2, 3);
+	CHECK(DeletedRecordings.Count() == 1 && Exists(deleted));
+	remover.SetRate(20);
+	CHECK(remover.Remove(deleted));
+	cCondWait::SleepMs(150);
+	CHECK(DeletedRecordings.Count() == 1);
+	CHECK(WaitFor(NoDeletedRecordings));
+	CHECK(!Exists(deleted));
+	// the remover counts what was recorded
+	CHECK(g_statistics.Counter(ctBytesRecorded) == bytes + MEGABYTE(6));
+	// and the directory it was in, like VDR does
+	CHECK(WaitFor(RemoverDirectoryGone));
+
+	// without a rate at once
+	deleted = MakeDeletedRecording("remover/fast", 1, 1);
+	remover.SetRate(0);
+	CHECK(remover.Remove(deleted));
+	CHECK(WaitFor(NoDeletedRecordings));
+	CHECK(!Exists(deleted));
+
+	// VDR may have taken it already
+	CHECK(remover.Remove(cString::sprintf("%s/remover/gone.del", VideoDirectory)));
+
+	// something that isn't in DeletedRecordings is left alone
+	cString other = cString::sprintf("%s/remover/other.del", VideoDirectory);
+	MakeDirs(other, true);
+	CHECK(remover.Remove(other));
+	cCondWait::SleepMs(100);
+	CHECK(Exists(other));
+
+	// while another VDR holds the lock, it's left to that one
+	deleted = MakeDeletedRecording("remover/locked", 1, 1);
+	cLockFile lockFile(VideoDirectory);
+	CHECK(lockFile.Lock());
+	CHECK(remover.Remove(deleted));
+	cCondWait::SleepMs(200);
+	CHECK(DeletedRecordings.Count() == 1 && Exists(deleted));
+	lockFile.Unlock();
+	DeletedRecordings.First()->Remove();
+	DeletedRecordings.Del(DeletedRecordings.First());
+
+	// a disk error while shrinking leaves the recording to VDR, the next
+	// one is removed as usual
+	remover.SetRate(20);
+	cString failing = MakeDeletedRecording("remover/eio", 1, 1);
+	ShimFault(scTruncate, failing, EIO);
+	CHECK(remover.Remove(failing));
+	deleted = MakeDeletedRecording("remover/after", 1, 1);
+	CHECK(remover.Remove(deleted));
+	CHECK(WaitFor(OneDeletedRecording));
+	CHECK(ShimHits(scTruncate) == 1);
+	CHECK(Exists(failing) && !Exists(deleted));
+	CHECK(!strcmp(DeletedRecordings.First()->FileName(), failing));
+	ShimClear();
+	DeletedRecordings.First()->Remove();
+	DeletedRecordings.Del(DeletedRecordings.First());
+
+	// one that can't be unlinked is forgotten, as VDR does
+	remover.SetRate(0);
+	failing = MakeDeletedRecording("remover/unlink", 1, 1);
+	ShimFault(scUnlink, failing, EIO);
+	CHECK(remover.Remove(failing));
+	CHECK(WaitFor(NoDeletedRecordings));
+	CHECK(ShimHits(scUnlink) >= 1 && Exists(failing));
+	ShimClear();
+	RemoveFileOrDir(failing);
+
+	// the queue is bounded, the rest is left to VDR
+	remover.SetRate(1);
+	deleted = MakeDeletedRecording("remover/busy", 1, 10);
+	CHECK(remover.Remove(deleted));
+	cCondWait::SleepMs(100);
+	int queued = 0;
+	for (int i = 0; i < REMOVERMAXQUEUE + 5; i++)
+	{
+		queued += remover.Remove(MakeDeletedRecording(cString::sprintf("remover/queued%d", i), 1, 1));
+	}
+	CHECK(queued == REMOVERMAXQUEUE);
+
+	// stopping doesn't wait for the slow removal, nor take anything after that
+	time_t t = time(NULL);
+	remover.Stop();
+	CHECK(time(NULL) - t <= 1);
+	CHECK(!remover.Remove(deleted));
+	CHECK(DeletedRecordings.Count() == REMOVERMAXQUEUE + 6);
+	CHECK(Exists(deleted));
+
+	// clean up like VDR
+	while (DeletedRecordings.First())
+	{
+		cRecording* recording = DeletedRecordings.First();
+		recording->Remove();
+		DeletedRecordings.Del(recording);
+	}
+}
+
+// the plugin
+
+static cPlugin* NewPlugin(void)
+{
+	cPlugin* plugin = (cPlugin*)VDRPluginCreator();
+	plugin->SetName("permashift");
+	plugin->SetupParse("KeepOnRestart", "1");
+	plugin->Start();
+	return plugin;
+}
+
+// VDR stops the plugin, then the recordings; the timers are saved
+static void Restart(cPlugin* &plugin)
+{
+	plugin->Stop();
+	delete plugin;
+	cRecordControls::Shutdown();
+	plugin = NewPlugin();
+}
+
+static bool GetInfo(cPlugin* plugin, Permashift_BufferInfo_v1_0* info)
+{
+	memset(info, 0, sizeof(*info));
+	return plugin->Service(PERMASHIFT_BUFFERINFO_V1_0, info);
+}
+
+static cString ReadFile(const char* fileName)
+{
+	char buffer[4096];
+	FILE* f = fopen(fileName, "r");
+	if (!f)
+	{
+		return NULL;
+	}
+	size_t n = fread(buffer, 1, sizeof(buffer) - 1, f);
+	fclose(f);
+	buffer[n] = 0;
+	return buffer;
+}
+
+static void TestJournal(void)
+{
+	cString journal = AddDirectory(cPlugin::ConfigDirectory("permashift"), "journal");
+	cPlugin* plugin = NewPlugin();
+
+	cDevice::StubSwitchChannel(1);
+	Permashift_BufferInfo_v1_0 info;
+	CHECK(GetInfo(plugin, &info) && info.active && info.channelNumber == 1);
+	CHECK(Timers.Count() == 1 && Recordings.Count() == 1);
+	CHECK(Timers.First() && Timers.First()->Priority() == TRANSFERPRIORITY - 1);
+	cString fileName = info.fileName;
+	CHECK(Recordings.First() && !strcmp(Recordings.First()->FileName(), fileName));
+
+	// two minutes of frames
+	for (int i = 0; i < 3000; i++)
+	{
+		Play(0x100, i);
+	}
+	time_t timerStart = Timers.First()->StartTime();
+
+	// the journal is written on Stop() and read on the next Start()
+	plugin->Stop();
+	cString text = ReadFile(journal);
+	CHECK(*text != NULL);
+	if (*text)
+	{
+		CHECK(strstr(text, "channel=T-1-1-101\n") != NULL);
+		CHECK(strstr(text, cString::sprintf("timer=%ld\n", long(timerStart))) != NULL);
+		CHECK(strstr(text, cString::sprintf("file=%s\n", *fileName)) != NULL);
+	}
+	delete plugin;
+	cRecordControls::Shutdown();
+	CHECK(Timers.Count() == 1 && Recordings.Count() == 1);
+	plugin = NewPlugin();
+	CHECK(!Exists(journal));
+
+	// back on the same channel, the recording goes on in its directory
+	cDevice::StubSwitchChannel(1);
+	CHECK(GetInfo(plugin, &info) && info.active && info.channelNumber == 1);
+	CHECK(!strcmp(info.fileName, fileName));
+	CHECK(Timers.Count() == 1 && Recordings.Count() == 1);
+	// its start is counted back from its length, not taken from before the restart
+	time_t now = time(NULL);
+	CHECK(info.startTime >= now - 121 && info.startTime <= now - 119);
+	// the inactivity timeout counts from the restart, not from that start
+	plugin->SetupParse("InactivityTimeout", "1");
+	for (int i = 0; i < 62; i++)
+	{
+		plugin->MainThreadHook();
+	}
+	plugin->SetupParse("InactivityTimeout", "0");
+	CHECK(StubConfirmations == 0);
+	Play(0x100, 0);
+	CHECK(FileSize(AddDirectory(fileName, "00002.ts")) == TS_SIZE);
+
+	// on another channel it's thrown away
+	Restart(plugin);
+	cDevice::StubSwitchChannel(2);
+	CHECK(GetInfo(plugin, &info) && info.active && info.channelNumber == 2);
+	CHECK(Timers.Count() == 1 && Timers.First()->Channel()->Number() == 2);
+	CHECK(Recordings.Count() == 1 && strcmp(Recordings.First()->FileName(), fileName));
+	CHECK(WaitFor(NoDeletedRecordings));
+	CHECK(!Exists(fileName));
+
+	// VDR may have started the timer before the switch to its channel
+	Restart(plugin);
+	plugin->SetupParse("AnalyzeStream", "1");
+	CHECK(cRecordControls::Start(Timers.First()));
+	cDevice::StubSwitchChannel(2);
+	CHECK(GetInfo(plugin, &info) && info.active && info.channelNumber == 2);
+	// the recorder and the analyzer
+	CHECK(cDevice::PrimaryDevice()->StubReceivers() == 2);
+	plugin->SetupParse("AnalyzeStream", "0");
+
+	// a normal stop deletes it
+	cString last = info.fileName;
+	plugin->SetupParse("KeepOnRestart", "0");
+	plugin->Stop();
+	delete plugin;
+	CHECK(!Exists(journal));
+	CHECK(Timers.Count() == 0 && Recordings.Count() == 0);
+	CHECK(!Exists(last));
+	cRecordControls::Shutdown();
+	while (DeletedRecordings.First())
+	{
+		cRecording* recording = DeletedRecordings.First();
+		recording->Remove();
+		DeletedRecordings.Del(recording);
+	}
+}
+
+static void TestCommands(void)
+{
+	cPlugin* plugin = NewPlugin();
+	int replyCode = 900;
+	cString reply = plugin->SVDRPCommand("STOP", "", replyCode);
+	CHECK(replyCode == 550);
+
+	cDevice::StubSwitchChannel(3);
+	replyCode = 900;
+	reply = plugin->SVDRPCommand("LSTB", "", replyCode);
+	CHECK(replyCode == 900 && *reply && !strncmp(reply, "3 Channel 3,", 12));
+
+	// a kept recording isn't stopped
+	reply = plugin->SVDRPCommand("KEEP", "", replyCode);
+	CHECK(replyCode == 900 && Timers.First() && Timers.First()->Priority() > Setup.PausePriority);
+	reply = plugin->SVDRPCommand("STOP", "", replyCode);
+	CHECK(replyCode == 550 && Recordings.Count() == 1);
+
+	// and survives the next channel switch
+	cDevice::StubSwitchChannel(1);
+	CHECK(Recordings.Count() == 2 && Timers.Count() == 2);
+	replyCode = 900;
+	reply = plugin->SVDRPCommand("STOP", "", replyCode);
+	CHECK(replyCode == 900 && Recordings.Count() == 1 && Timers.Count() == 1);
+
+	plugin->SetupParse("KeepOnRestart", "0");
+	plugin->Stop();
+	delete plugin;
+	cRecordControls::Shutdown();
+}
+
+static void TestPauseForRecordings(void)
+{
+	cPlugin* plugin = NewPlugin();
+	plugin->SetupParse("PauseForRecordings", "1");
+	cTimer* other = new cTimer(false, false, Channels.GetByNumber(3));
+	other->SetRecording(true);
+	Timers.Add(other);
+	int timers = Timers.Count();
+	Permashift_BufferInfo_v1_0 info;
+
+	// not started while another timer records
+	cDevice::StubSwitchChannel(1);
+	CHECK(GetInfo(plugin, &info) && !info.active);
+	CHECK(Timers.Count() == timers);
+
+	// started once it's done
+	other->SetRecording(false);
+	plugin->MainThreadHook();
+	CHECK(GetInfo(plugin, &info) && info.active && info.channelNumber == 1);
+	CHECK(Timers.Count() == timers + 1);
+	cString fileName = info.fileName;
+
+	// and stopped when it records again
+	other->SetRecording(true);
+	plugin->MainThreadHook();
+	CHECK(GetInfo(plugin, &info) && !info.active);
+	CHECK(Timers.Count() == timers);
+	CHECK(Recordings.GetByName(fileName) == NULL);
+
+	plugin->SetupParse("PauseForRecordings", "0");
+	plugin->SetupParse("KeepOnRestart", "0");
+	Timers.Del(other);
+	plugin->Stop();
+	delete plugin;
+	cRecordControls::Shutdown();
+}
+
+int main(int argc, char *argv[])
+{
+	StubVerbose = argc > 1 && !strcmp(argv[1], "-v");
+
+	char directory[] = "/tmp/permashift-test-XXXXXX";
+	if (!mkdtemp(directory))
+	{
+		perror(directory);
+		return 2;
+	}
+	g_testDirectory = directory;
+	cString videoDirectory = AddDirectory(directory, "video");
+	MakeDirs(videoDirectory, true);
+	VideoDirectory = videoDirectory;
+	cPlugin::SetConfigDirectory(AddDirectory(directory, "config"));
+	for (int i = 1; i <= 3; i++)
+	{
+		Channels.Add(new cChannel(i, cString::sprintf("Channel %d", i), 100 + i));
+	}
+
+	TestHistogram();
+	TestSnapshot();
+	TestContinuity();
+	TestFlightRecorder();
+	TestWatchdog();
+	TestRemover();
+	TestJournal();
+	TestCommands();
+	TestPauseForRecordings();
+
+	RemoveFileOrDir(directory);
+	printf("%d checks, %d failed\n", checks, failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,5 @@
+/*
+ * channels.h: See stub.h
+ */
+
+#include "stub.h"
@@ -0,0 +1,5 @@
+/*
+ * config.h: See stub.h
+ */
+
+#include "stub.h"
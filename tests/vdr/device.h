@@ -0,0 +1,5 @@
+/*
+ * device.h: See stub.h
+ */
+
+#include "stub.h"
@@ -0,0 +1,5 @@
+/*
+ * interface.h: See stub.h
+ */
+
+#include "stub.h"
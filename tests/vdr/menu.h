@@ -0,0 +1,5 @@
+/*
+ * menu.h: See stub.h
+ */
+
+#include "stub.h"
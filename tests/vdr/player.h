@@ -0,0 +1,5 @@
+/*
+ * player.h: See stub.h
+ */
+
+#include "stub.h"
@@ -0,0 +1,5 @@
+/*
+ * plugin.h: See stub.h
+ */
+
+#include "stub.h"
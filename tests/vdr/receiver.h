@@ -0,0 +1,5 @@
+/*
+ * receiver.h: See stub.h
+ */
+
+#include "stub.h"
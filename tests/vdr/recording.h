@@ -0,0 +1,5 @@
+/*
+ * recording.h: See stub.h
+ */
+
+#include "stub.h"
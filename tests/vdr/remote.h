@@ -0,0 +1,5 @@
+/*
+ * remote.h: See stub.h
+ */
+
+#include "stub.h"
@@ -0,0 +1,5 @@
+/*
+ * shutdown.h: See stub.h
+ */
+
+#include "stub.h"
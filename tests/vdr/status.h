@@ -0,0 +1,5 @@
+/*
+ * status.h: See stub.h
+ */
+
+#include "stub.h"
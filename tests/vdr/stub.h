@@ -0,0 +1,640 @@
+/*
+ * stub.h: Stand-in for the parts of VDR the plugin uses
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Just enough of VDR's API to build the plugin and drive it from a test
+ * program, without VDR and without DVB hardware. Where the plugin depends
+ * on how VDR behaves (timers, record controls, the recording lists and the
+ * status messages), the stub does what VDR 2.0 does. The functions named
+ * Stub...() don't exist in VDR, they're for the tests only.
+ */
+
+#ifndef __PERMASHIFT_STUB_H
+#define __PERMASHIFT_STUB_H
+
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+typedef unsigned char uchar;
+
+// tools
+
+extern bool StubVerbose;
+void StubLog(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
+
+#define esyslog(a...) StubLog(a)
+#define isyslog(a...) StubLog(a)
+#define dsyslog(a...) StubLog(a)
+#define LOG_ERROR         esyslog("ERROR (%s,%d): %m", __FILE__, __LINE__)
+#define LOG_ERROR_STR(s) esyslog("ERROR (%s,%d): %s: %m", __FILE__, __LINE__, s)
+
+#define tr(s)     (s)
+#define trNOOP(s) (s)
+
+#define MEGABYTE(n) ((n) * 1024LL * 1024LL)
+#define DELETENULL(p) (delete (p), p = NULL)
+
+template<class T> inline T min(T a, T b) { return a <= b ? a : b; }
+template<class T> inline T max(T a, T b) { return a >= b ? a : b; }
+
+char *strn0cpy(char *dest, const char *src, size_t n);
+bool MakeDirs(const char *FileName, bool IsDirectory = false);
+bool RemoveFileOrDir(const char *FileName);
+// files and bytes written by the recorders, files removed by RemoveFileOrDir()
+extern int StubFilesCreated;
+extern int StubFilesRemoved;
+extern uint64_t StubBytesWritten;
+bool RemoveEmptyDirectories(const char *DirName, bool RemoveThis = false, const char *IgnoreFiles[] = NULL);
+
+class cString
+{
+private:
+	char *s;
+
+public:
+	cString(const char *S = NULL, bool TakePointer = false);
+	cString(const cString &String);
+	virtual ~cString();
+	operator const char * () const { return s; }
+	const char * operator*() const { return s; }
+	cString &operator=(const cString &String);
+	cString &operator=(const char *String);
+	static cString sprintf(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
+};
+
+cString AddDirectory(const char *DirName, const char *FileName);
+
+class cStringList
+{
+private:
+	std::vector<char *> m_strings;
+
+public:
+	~cStringList() { Clear(); }
+	int Size(void) const { return int(m_strings.size()); }
+	void Append(char *s) { m_strings.push_back(s); }
+	void Remove(int Index) { m_strings.erase(m_strings.begin() + Index); }
+	char *operator[](int Index) const { return m_strings[Index]; }
+	void Clear(void);
+};
+
+class cReadLine
+{
+private:
+	size_t size;
+	char *buffer;
+
+public:
+	cReadLine(void) : size(0), buffer(NULL) {}
+	~cReadLine() { free(buffer); }
+	char *Read(FILE *f);
+};
+
+class cReadDir
+{
+private:
+	DIR *directory;
+
+public:
+	cReadDir(const char *Directory);
+	~cReadDir();
+	bool Ok(void) { return directory != NULL; }
+	struct dirent *Next(void);
+};
+
+// writes to a temporary file, which replaces the file on Close()
+class cSafeFile
+{
+private:
+	char *fileName;
+	char *tempName;
+	FILE *f;
+
+public:
+	cSafeFile(const char *FileName);
+	~cSafeFile();
+	operator FILE* () { return f; }
+	bool Open(void);
+	bool Close(void);
+};
+
+// only one holder of the lock file in a directory at a time
+class cLockFile
+{
+private:
+	char *fileName;
+	int f;
+
+public:
+	cLockFile(const char *Directory);
+	~cLockFile();
+	bool Lock(int WaitSeconds = 0);
+	void Unlock(void);
+};
+
+class cListObject
+{
+	friend class cListBase;
+
+private:
+	cListObject *prev, *next;
+
+public:
+	cListObject(void) : prev(NULL), next(NULL) {}
+	virtual ~cListObject() {}
+	cListObject *Prev(void) const { return prev; }
+	cListObject *Next(void) const { return next; }
+};
+
+class cListBase
+{
+protected:
+	cListObject *objects, *lastObject;
+	int count;
+
+public:
+	cListBase(void) : objects(NULL), lastObject(NULL), count(0) {}
+	virtual ~cListBase() { Clear(); }
+	void Add(cListObject *Object, cListObject *After = NULL);
+	void Del(cListObject *Object, bool DeleteObject = true);
+	virtual void Clear(void);
+	int Count(void) const { return count; }
+};
+
+template<class T> class cList : public cListBase
+{
+public:
+	T *First(void) const { return (T *)objects; }
+	T *Last(void) const { return (T *)lastObject; }
+	T *Prev(const T *object) const { return (T *)object->cListObject::Prev(); }
+	T *Next(const T *object) const { return (T *)object->cListObject::Next(); }
+};
+
+// thread
+
+class cMutex
+{
+	friend class cCondVar;
+
+private:
+	pthread_mutex_t mutex;
+
+public:
+	cMutex(void);
+	~cMutex();
+	void Lock(void);
+	void Unlock(void);
+};
+
+class cMutexLock
+{
+private:
+	cMutex *mutex;
+
+public:
+	cMutexLock(cMutex *Mutex = NULL);
+	~cMutexLock();
+};
+
+class cCondWait
+{
+private:
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool signaled;
+
+public:
+	cCondWait(void);
+	~cCondWait();
+	static void SleepMs(int TimeoutMs);
+	bool Wait(int TimeoutMs = 0);
+	void Signal(void);
+};
+
+class cCondVar
+{
+private:
+	pthread_cond_t cond;
+
+public:
+	cCondVar(void);
+	~cCondVar();
+	void Wait(cMutex &Mutex);
+	bool TimedWait(cMutex &Mutex, int TimeoutMs);
+	void Broadcast(void);
+};
+
+class cThread
+{
+	friend class cThreadLock;
+
+private:
+	volatile bool active;
+	volatile bool running;
+	pthread_t childTid;
+	cMutex mutex;
+	static void *StartThread(cThread *Thread);
+
+protected:
+	void SetPriority(int Priority) {}
+	void SetIOPriority(int Priority) {}
+	void Lock(void) { mutex.Lock(); }
+	void Unlock(void) { mutex.Unlock(); }
+	virtual void Action(void) = 0;
+	bool Running(void) { return running; }
+	void Cancel(int WaitSeconds = 0);
+
+public:
+	cThread(const char *Description = NULL, bool LowPriority = false);
+	virtual ~cThread();
+	bool Start(void);
+	bool Active(void) { return active; }
+};
+
+class cThreadLock
+{
+private:
+	cThread *thread;
+
+public:
+	cThreadLock(cThread *Thread = NULL);
+	~cThreadLock();
+};
+
+// config
+
+#define MAXPRIORITY      99
+#define MINPRIORITY      (-MAXPRIORITY)
+#define LIVEPRIORITY     0
+#define TRANSFERPRIORITY (LIVEPRIORITY - 1)
+#define MAXLIFETIME      99
+
+struct cSetup
+{
+	int InstantRecordTime;
+	int DefaultPriority;
+	int DefaultLifetime;
+	int PausePriority;
+	int PauseLifetime;
+	cSetup(void);
+};
+
+extern cSetup Setup;
+
+// channels
+
+struct tChannelID
+{
+	int sid;
+	tChannelID(void) : sid(0) {}
+	bool operator==(const tChannelID &arg) const { return sid == arg.sid; }
+	static tChannelID FromString(const char *s);
+	cString ToString(void) const;
+};
+
+class cChannel : public cListObject
+{
+private:
+	int number;
+	cString name;
+	int sid;
+
+public:
+	cChannel(int Number = 0, const char *Name = "", int Sid = 0) : number(Number), name(Name), sid(Sid) {}
+	int Number(void) const { return number; }
+	const char *Name(void) const { return name; }
+	tChannelID GetChannelID(void) const;
+};
+
+class cChannels : public cList<cChannel>
+{
+public:
+	cChannel *GetByNumber(int Number, int SkipGap = 0);
+};
+
+extern cChannels Channels;
+
+// timers
+
+enum eTimerChange { tcMod, tcAdd, tcDel };
+
+class cTimer : public cListObject
+{
+private:
+	time_t day;
+	int start, stop;
+	int priority, lifetime;
+	bool recording;
+	cChannel *channel;
+
+public:
+	// an instant timer on the current channel, like VDR's cTimer(true, Pause)
+	cTimer(bool Instant = false, bool Pause = false, cChannel *Channel = NULL);
+	int Start(void) const { return start; }
+	int Stop(void) const { return stop; }
+	int Priority(void) const { return priority; }
+	int Lifetime(void) const { return lifetime; }
+	cChannel *Channel(void) const { return channel; }
+	void SetPriority(int Priority) { priority = Priority; }
+	void SetLifetime(int Lifetime) { lifetime = Lifetime; }
+	void SetStop(int Stop) { stop = Stop; }
+	void SetRecording(bool Recording) { recording = Recording; }
+	bool Recording(void) const { return recording; }
+	bool IsSingleEvent(void) const { return true; }
+	time_t StartTime(void) const;
+	time_t StopTime(void) const;
+	bool Matches(time_t t) const { return StartTime() <= t && t < StopTime(); }
+	// moves the timer to the next day, so it doesn't match anymore
+	void Skip(void) { day += 24 * 3600; }
+};
+
+class cTimers : public cList<cTimer>
+{
+public:
+	void Add(cTimer *Timer, cTimer *After = NULL);
+	void Del(cTimer *Timer, bool DeleteObject = true);
+	bool Save(void) { return true; }
+	void SetModified(void) {}
+};
+
+extern cTimers Timers;
+
+// recordings
+
+#define DEFAULTFRAMESPERSECOND 25.0
+
+class cRecording : public cListObject
+{
+	friend class cRecordings;
+
+private:
+	char *fileName;
+
+public:
+	cRecording(const char *FileName);
+	virtual ~cRecording();
+	const char *FileName(void) const { return fileName; }
+	const char *Name(void) const { return fileName; }
+	double FramesPerSecond(void) const { return DEFAULTFRAMESPERSECOND; }
+	// renames the directory from ".rec" to ".del"
+	bool Delete(void);
+	// removes the directory
+	bool Remove(void);
+};
+
+class cRecordings : public cList<cRecording>, public cThread
+{
+protected:
+	virtual void Action(void) {}
+
+public:
+	cRecording *GetByName(const char *FileName);
+	void AddByName(const char *FileName);
+	// moves the recording to DeletedRecordings
+	void DelByName(const char *FileName);
+};
+
+extern cRecordings Recordings;
+extern cRecordings DeletedRecordings;
+
+// VDR's index of a TS recording, one entry per frame
+struct tIndexTs
+{
+	uint64_t offset:40;
+	int reserved:7;
+	int independent:1;
+	uint16_t number:16;
+};
+
+class cIndexFile
+{
+private:
+	std::vector<tIndexTs> index;
+
+public:
+	cIndexFile(const char *FileName, bool Record, bool IsPesRecording = false, bool PauseLive = false);
+	bool Ok(void) { return true; }
+	bool Get(int Index, uint16_t *FileNumber, off_t *FileOffset, bool *Independent = NULL, int *Length = NULL);
+	int Last(void) { return int(index.size()) - 1; }
+};
+
+// devices
+
+#define TS_SIZE      188
+#define TS_SYNC_BYTE 0x47
+
+class cReceiver;
+
+class cDevice
+{
+private:
+	std::vector<cReceiver *> receivers;
+	static int currentChannel;
+
+public:
+	static cDevice *PrimaryDevice(void);
+	static cDevice *ActualDevice(void) { return PrimaryDevice(); }
+	static int CurrentChannel(void) { return currentChannel; }
+	bool AttachReceiver(cReceiver *Receiver);
+	void Detach(cReceiver *Receiver);
+	// hands TS packets to all attached receivers, like a tuner would
+	void StubPlayTs(uchar *Data, int Length);
+	// tells the status monitors about a channel switch, like SwitchChannel()
+	static void StubSwitchChannel(int Number);
+	int StubReceivers(void) { return receivers.size(); }
+};
+
+class cReceiver
+{
+	friend class cDevice;
+
+private:
+	cDevice *device;
+
+protected:
+	virtual void Activate(bool On) {}
+	virtual void Receive(uchar *Data, int Length) = 0;
+
+public:
+	cReceiver(const cChannel *Channel = NULL, int Priority = MINPRIORITY) : device(NULL) {}
+	virtual ~cReceiver();
+	bool IsAttached(void) { return device != NULL; }
+	void Detach(void);
+};
+
+// records
+
+class cStubRecorder;
+
+class cRecordControl
+{
+private:
+	cDevice *device;
+	cTimer *timer;
+	char *fileName;
+	cStubRecorder *recorder;
+
+public:
+	cRecordControl(cDevice *Device, cTimer *Timer = NULL, bool Pause = false);
+	virtual ~cRecordControl();
+	bool Process(time_t t);
+	cDevice *Device(void) { return device; }
+	const char *FileName(void) { return fileName; }
+	cTimer *Timer(void) { return timer; }
+};
+
+class cRecordControls
+{
+private:
+	static std::vector<cRecordControl *> recordControls;
+
+public:
+	static bool Start(cTimer *Timer = NULL, bool Pause = false);
+	static cRecordControl *GetRecordControl(const cTimer *Timer);
+	static void Process(time_t t);
+	static void Shutdown(void);
+};
+
+// status
+
+class cControl
+{
+public:
+	static cControl *Control(bool Hidden = false) { return NULL; }
+	virtual bool GetIndex(int &Current, int &Total, bool SnapToIFrame = false) { return false; }
+	virtual bool GetReplayMode(bool &Play, bool &Forward, int &Speed) { return false; }
+};
+
+class cStatus : public cListObject
+{
+private:
+	static cList<cStatus> statusMonitors;
+
+protected:
+	virtual void ChannelSwitch(const cDevice *Device, int ChannelNumber, bool LiveView) {}
+	virtual void TimerChange(const cTimer *Timer, eTimerChange Change) {}
+	virtual void Recording(const cDevice *Device, const char *Name, const char *FileName, bool On) {}
+	virtual void Replaying(const cControl *Control, const char *Name, const char *FileName, bool On) {}
+
+public:
+	cStatus(void);
+	virtual ~cStatus();
+	static void MsgChannelSwitch(const cDevice *Device, int ChannelNumber, bool LiveView);
+	static void MsgTimerChange(const cTimer *Timer, eTimerChange Change);
+	static void MsgRecording(const cDevice *Device, const char *Name, const char *FileName, bool On);
+};
+
+class cShutdownHandler
+{
+public:
+	bool IsUserInactive(time_t AtTime = 0) { return false; }
+};
+
+extern cShutdownHandler ShutdownHandler;
+
+class cRemote
+{
+public:
+	static time_t LastActivity(void) { return 0; }
+};
+
+// nobody answers, the prompts are counted
+extern int StubConfirmations;
+
+class cInterface
+{
+public:
+	bool Confirm(const char *s, int Seconds = 10, bool WaitForTimeout = false) { StubConfirmations++; return false; }
+};
+
+extern cInterface *Interface;
+
+// video directory
+
+extern const char *VideoDirectory;
+int VideoDiskSpace(int *FreeMB = NULL, int *UsedMB = NULL);
+void RemoveEmptyVideoDirectories(const char *IgnoreFiles[] = NULL);
+
+// menus
+
+class cOsdItem : public cListObject
+{
+};
+
+class cOsdMenu
+{
+private:
+	cList<cOsdItem> items;
+
+public:
+	virtual ~cOsdMenu() {}
+	void Add(cOsdItem *Item, bool Current = false, cOsdItem *After = NULL) { items.Add(Item, After); }
+};
+
+class cMenuSetupPage : public cOsdMenu
+{
+protected:
+	void SetupStore(const char *Name, int Value) {}
+	virtual void Store(void) = 0;
+};
+
+class cMenuEditBoolItem : public cOsdItem
+{
+public:
+	cMenuEditBoolItem(const char *Name, int *Value, const char *FalseString = NULL, const char *TrueString = NULL) {}
+};
+
+class cMenuEditIntItem : public cOsdItem
+{
+public:
+	cMenuEditIntItem(const char *Name, int *Value, int Min = 0, int Max = 1000, const char *MinString = NULL, const char *MaxString = NULL) {}
+};
+
+// plugins
+
+class cPlugin
+{
+private:
+	const char *name;
+	static char *configDirectory;
+
+public:
+	cPlugin(void) : name(NULL) {}
+	virtual ~cPlugin() {}
+	const char *Name(void) { return name; }
+	void SetName(const char *s) { name = s; }
+	static void SetConfigDirectory(const char *Dir);
+	static const char *ConfigDirectory(const char *PluginName = NULL);
+
+	virtual const char *Version(void) = 0;
+	virtual const char *Description(void) = 0;
+	virtual const char *CommandLineHelp(void) { return NULL; }
+	virtual bool ProcessArgs(int argc, char *argv[]) { return true; }
+	virtual bool Initialize(void) { return true; }
+	virtual bool Start(void) { return true; }
+	virtual void Stop(void) {}
+	virtual void Housekeeping(void) {}
+	virtual void MainThreadHook(void) {}
+	virtual cString Active(void) { return NULL; }
+	virtual const char *MainMenuEntry(void) { return NULL; }
+	virtual cOsdMenu *MainMenuAction(void) { return NULL; }
+	virtual cMenuSetupPage *SetupMenu(void) { return NULL; }
+	virtual bool SetupParse(const char *Name, const char *Value) { return false; }
+	virtual bool Service(const char *Id, void *Data = NULL) { return false; }
+	virtual const char **SVDRPHelpPages(void) { return NULL; }
+	virtual cString SVDRPCommand(const char *Command, const char *Option, int &ReplyCode) { return NULL; }
+};
+
+#define VDRPLUGINCREATOR(PluginClass) extern "C" void *VDRPluginCreator(void) { return new PluginClass; }
+
+#endif
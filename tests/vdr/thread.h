@@ -0,0 +1,5 @@
+/*
+ * thread.h: See stub.h
+ */
+
+#include "stub.h"
@@ -0,0 +1,5 @@
+/*
+ * timers.h: See stub.h
+ */
+
+#include "stub.h"
@@ -0,0 +1,5 @@
+/*
+ * tools.h: See stub.h
+ */
+
+#include "stub.h"
@@ -0,0 +1,5 @@
+/*
+ * videodir.h: See stub.h
+ */
+
+#include "stub.h"
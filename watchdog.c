@@ -0,0 +1,82 @@
+/*
+ * watchdog.c: Watches the recorder writing the timeshift recording
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include "watchdog.h"
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+cPermashiftWatchdog::cPermashiftWatchdog(const char* fileName) :
+	m_stopped(false), m_indexName(AddDirectory(fileName, "index")),
+	m_size(-1), m_growth(time(NULL))
+{
+}
+
+cPermashiftWatchdog::~cPermashiftWatchdog()
+{
+}
+
+cPermashiftWatchdog* cPermashiftWatchdog::Start(const char* fileName)
+{
+	cPermashiftWatchdog* watchdog = new cPermashiftWatchdog(fileName);
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, &StartThread, watchdog) != 0)
+	{
+		LOG_ERROR;
+		delete watchdog;
+		return NULL;
+	}
+	pthread_detach(thread);
+	return watchdog;
+}
+
+void* cPermashiftWatchdog::StartThread(void* watchdog)
+{
+	((cPermashiftWatchdog*)watchdog)->Action();
+	// after Stop() nobody else knows of it
+	delete (cPermashiftWatchdog*)watchdog;
+	return NULL;
+}
+
+void cPermashiftWatchdog::Stop(void)
+{
+	cMutexLock lock(&m_mutex);
+	m_stopped = true;
+	m_wake.Broadcast();
+}
+
+time_t cPermashiftWatchdog::LastGrowth(void)
+{
+	cMutexLock lock(&m_mutex);
+	return m_growth;
+}
+
+void cPermashiftWatchdog::Action(void)
+{
+	setpriority(PRIO_PROCESS, 0, 19);
+
+	m_mutex.Lock();
+	while (!m_stopped)
+	{
+		// the stat() may hang, so it's done without the lock
+		m_mutex.Unlock();
+		struct stat st;
+		bool ok = stat(m_indexName, &st) == 0;
+		m_mutex.Lock();
+		if (ok && st.st_size > m_size)
+		{
+			m_size = st.st_size;
+			m_growth = time(NULL);
+		}
+		if (!m_stopped)
+		{
+			m_wake.TimedWait(m_mutex, 1000);
+		}
+	}
+	m_mutex.Unlock();
+}
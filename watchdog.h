@@ -0,0 +1,50 @@
+/*
+ * watchdog.h: Watches the recorder writing the timeshift recording
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __PERMASHIFT_WATCHDOG_H
+#define __PERMASHIFT_WATCHDOG_H
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+// The recorder appends to the index with every frame it writes. A thread
+// looks at the size of the index once a second, so a hanging network disk
+// only blocks that thread and never VDR's main thread.
+//
+// Each recording gets a watchdog of its own. Stop() doesn't wait for the
+// thread: one stuck in stat() deletes its watchdog whenever stat() returns,
+// and never shares anything with the watchdog of the next recording. It's
+// no cThread, because cThread still uses its object after Action() returns.
+
+class cPermashiftWatchdog
+{
+private:
+	cMutex m_mutex;
+	cCondVar m_wake;
+	bool m_stopped;
+	cString m_indexName;
+	off_t m_size;
+	// last time the index grew
+	time_t m_growth;
+
+	cPermashiftWatchdog(const char* fileName);
+	~cPermashiftWatchdog();
+
+	static void* StartThread(void* watchdog);
+	void Action(void);
+
+public:
+	// watch the recording in the given directory, NULL if there's no thread
+	static cPermashiftWatchdog* Start(const char* fileName);
+	// the watchdog must not be used anymore afterwards
+	void Stop(void);
+
+	// last time the index was seen growing, or when watching started
+	time_t LastGrowth(void);
+};
+
+#endif